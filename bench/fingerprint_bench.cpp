@@ -0,0 +1,56 @@
+// Опознание сервисов по баннерам встроенными сигнатурами: пропускная
+// способность Fingerprints::match в МБ/с на смеси опознаваемых и
+// неопознаваемых баннеров.
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "fingerprint.hpp"
+
+static double seconds_since(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+int main() {
+    Fingerprints fp;
+    std::string err;
+    if (!fp.load_builtin(err)) {
+        std::cerr << "❌ " << err << "\n";
+        return 1;
+    }
+
+    const std::vector<std::string> banners = {
+        "SSH-2.0-OpenSSH_9.2p1 Debian-2+deb12u3\r\n",
+        "HTTP/1.1 200 OK\r\nServer: nginx/1.24.0\r\nDate: Sat, 17 Oct 2026 07:19:26 GMT\r\n"
+        "Content-Type: text/html; charset=utf-8\r\nContent-Length: 4096\r\nConnection: close\r\n\r\n",
+        "HTTP/1.0 404 Not Found\r\nContent-Type: text/plain\r\nContent-Length: 9\r\n\r\nnot found",
+        "220 mail.example.com ESMTP Postfix (Debian/GNU)\r\n",
+        "+OK Dovecot ready.\r\n",
+        "+PONG\r\n",
+        std::string("J\0\0\0\x0a" "8.0.36\0\x08\0\0\0abcdefgh\0", 28),
+        std::string("\x16\x03\x03\x00\x4a\x02\x00\x00\x46\x03\x03 binary tls", 22),
+        "Welcome to the service, please authenticate.\r\n",
+    };
+
+    const size_t n = 200000;
+    std::mt19937 rng(1);
+    std::vector<const std::string*> input(n);
+    size_t bytes = 0;
+    for (size_t i = 0; i < n; i++) {
+        input[i] = &banners[rng() % banners.size()];
+        bytes += input[i]->size();
+    }
+    std::cout << fp.size() << " signatures, " << n << " banners, " << bytes / n
+              << " bytes on average\n";
+
+    ServiceInfo info;
+    size_t matched = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (const auto* b : input) matched += fp.match(*b, info);
+    double s = seconds_since(t0);
+
+    std::cout << "  match: " << (uint64_t)(n / s) << " banners/s, "
+              << (uint64_t)(bytes / s / 1e6) << " MB/s, " << matched * 100 / n << "% identified\n";
+    return 0;
+}
@@ -0,0 +1,74 @@
+// Таблица проб в полёте против std::unordered_map под мьютексом:
+// 1M+ записей, вставка -> пометка ответа (из второго потока) -> удаление.
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "inflight_table.hpp"
+
+static double seconds_since(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+static uint32_t probe_ip(size_t i) { return 0x0a000000 + (uint32_t)(i * 2654435761u % 0xffffff); }
+static uint16_t probe_port(size_t i) { return (uint16_t)(1 + i % 65535); }
+
+int main() {
+    for (size_t n : {1000000, 4000000}) {
+        // --- Открытая адресация ---
+        InflightTable table(n);
+        auto t0 = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < n; ++i) table.insert(probe_ip(i), probe_port(i), i);
+        double insert_s = seconds_since(t0);
+
+        t0 = std::chrono::steady_clock::now();
+        size_t marked = 0;
+        std::thread rx([&] {
+            uint8_t attempt;
+            uint64_t sent;
+            for (size_t i = 0; i < n; ++i) {
+                marked += table.mark_answered(probe_ip(i), probe_port(i), attempt, sent);
+            }
+        });
+        rx.join();
+        double mark_s = seconds_since(t0);
+
+        t0 = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < n; ++i) table.erase(probe_ip(i), probe_port(i));
+        double erase_s = seconds_since(t0);
+
+        // --- unordered_map под мьютексом (как было до таблицы) ---
+        struct Probe {
+            uint64_t sent_us;
+            uint8_t attempt;
+        };
+        std::mutex mtx;
+        std::unordered_map<uint64_t, Probe> map;
+        auto key = [](size_t i) { return ((uint64_t)probe_ip(i) << 16) | probe_port(i); };
+        t0 = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < n; ++i) {
+            std::lock_guard<std::mutex> lock(mtx);
+            map[key(i)] = {i, 0};
+        }
+        double map_insert_s = seconds_since(t0);
+        t0 = std::chrono::steady_clock::now();
+        std::thread rx2([&] {
+            for (size_t i = 0; i < n; ++i) {
+                std::lock_guard<std::mutex> lock(mtx);
+                map.erase(key(i));
+            }
+        });
+        rx2.join();
+        double map_erase_s = seconds_since(t0);
+
+        std::cout << n << " probes (" << marked << " marked, huge pages: "
+                  << (table.huge_pages() ? "hugetlb" : "thp hint") << ")\n"
+                  << "  table: insert " << (uint64_t)(n / insert_s) << "/s, mark "
+                  << (uint64_t)(n / mark_s) << "/s, erase " << (uint64_t)(n / erase_s) << "/s\n"
+                  << "  map:   insert " << (uint64_t)(n / map_insert_s) << "/s, erase "
+                  << (uint64_t)(n / map_erase_s) << "/s\n";
+    }
+    return 0;
+}
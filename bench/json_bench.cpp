@@ -0,0 +1,83 @@
+// Сериализация результатов с баннерами: посимвольный json_escape через
+// std::ostringstream и вывод через iostream (как было) против JsonWriter.
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <vector>
+#include "json_writer.hpp"
+
+static double seconds_since(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+static std::string old_escape(const std::string& s) {
+    std::ostringstream oss;
+    for (char c : s) {
+        switch (c) {
+            case '\"': oss << "\\\""; break;
+            case '\\': oss << "\\\\"; break;
+            case '\n': oss << "\\n"; break;
+            case '\r': oss << "\\r"; break;
+            case '\t': oss << "\\t"; break;
+            default: oss << c; break;
+        }
+    }
+    return oss.str();
+}
+
+int main() {
+    const std::vector<std::string> banners = {
+        "",
+        "SSH-2.0-OpenSSH_9.2p1 Debian-2+deb12u3\r\n",
+        "HTTP/1.1 200 OK\r\nServer: nginx/1.24.0\r\nDate: Sat, 17 Oct 2026 07:19:26 GMT\r\n"
+        "Content-Type: text/html; charset=utf-8\r\nContent-Length: 4096\r\nConnection: close\r\n"
+        "Set-Cookie: session=\"abc\"; Path=/; HttpOnly\r\n\r\n<!DOCTYPE html><html><head>"
+        "<title>Welcome</title></head><body>",
+        "220 mail.example.com ESMTP Postfix (Debian/GNU)\r\n",
+        std::string("\x16\x03\x03\x00\x4a\x02\x00\x00\x46\x03\x03 binary \\ tls", 24),
+    };
+
+    const size_t n = 2000000;
+    std::mt19937 rng(1);
+    std::vector<ScanResult> results(n);
+    size_t banner_bytes = 0;
+    for (size_t i = 0; i < n; i++) {
+        results[i] = {0x0a000000u + (uint32_t)i, (int)(1 + rng() % 65535), true,
+                      banners[rng() % banners.size()]};
+        banner_bytes += results[i].banner.size();
+    }
+    std::cout << n << " results, " << banner_bytes / n << " banner bytes on average\n";
+
+    // --- iostream ---
+    auto t0 = std::chrono::steady_clock::now();
+    std::ostringstream old_out;
+    for (const auto& r : results) {
+        old_out << "{\"ip\": " << r.ip << ", \"port\": " << r.port
+                << ", \"open\": " << (r.open ? "true" : "false")
+                << ", \"banner\": \"" << old_escape(r.banner) << "\"}\n";
+    }
+    double old_s = seconds_since(t0);
+    size_t old_bytes = old_out.str().size();
+
+    // --- JsonWriter в переиспользуемый буфер ---
+    std::string buf;
+    size_t new_bytes = 0;
+    t0 = std::chrono::steady_clock::now();
+    for (const auto& r : results) {
+        JsonWriter::append_result(buf, r);
+        buf += '\n';
+        if (buf.size() >= (1 << 20)) {
+            new_bytes += buf.size();
+            buf.clear();
+        }
+    }
+    new_bytes += buf.size();
+    double new_s = seconds_since(t0);
+
+    std::cout << "  iostream:   " << (uint64_t)(n / old_s) << " records/s, "
+              << (uint64_t)(old_bytes / old_s / 1e6) << " MB/s\n"
+              << "  JsonWriter: " << (uint64_t)(n / new_s) << " records/s, "
+              << (uint64_t)(new_bytes / new_s / 1e6) << " MB/s\n";
+    return 0;
+}
@@ -0,0 +1,53 @@
+// Сравнение полной сборки SYN (build_syn_packet) с шаблоном (SynTemplate):
+// пакетов в секунду на одно ядро и побайтовое совпадение результатов.
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include "packet_template.hpp"
+
+static const uint32_t kSrc = 0x0a000001;   // 10.0.0.1
+static const int kPackets = 20000000;
+
+static uint32_t probe_ip(int i) { return 0x0a000000 + (uint32_t)i * 2654435761u % 0xffffff; }
+static uint16_t probe_port(int i) { return (uint16_t)(1 + i % 65535); }
+static uint16_t probe_sport(int i) { return (uint16_t)(40000 + i % 20000); }
+static uint32_t probe_seq(int i) { return (uint32_t)i * 0x9e3779b9u; }
+
+template <typename F>
+static double measure(const char* name, F build) {
+    uint8_t pkt[kSynPacketLen];
+    uint32_t sink = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < kPackets; ++i) {
+        build(pkt, i);
+        sink += pkt[10] + pkt[36];   // чтобы компилятор не выбросил сборку
+    }
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    double pps = kPackets / sec;
+    std::cout << name << ": " << (uint64_t)pps << " pkt/s (" << sink % 10 << ")\n";
+    return pps;
+}
+
+int main() {
+    SynTemplate tmpl(kSrc);
+
+    // --- Проверка: шаблон даёт те же байты, что и полная сборка ---
+    for (int i = 0; i < 1000000; ++i) {
+        uint8_t a[kSynPacketLen], b[kSynPacketLen];
+        build_syn_packet(a, kSrc, probe_ip(i), probe_sport(i), probe_port(i), probe_seq(i));
+        tmpl.build(b, probe_ip(i), probe_sport(i), probe_port(i), probe_seq(i));
+        if (std::memcmp(a, b, kSynPacketLen) != 0) {
+            std::cerr << "❌ Пакеты расходятся на итерации " << i << "\n";
+            return 1;
+        }
+    }
+
+    double full = measure("build_syn_packet", [](uint8_t* out, int i) {
+        build_syn_packet(out, kSrc, probe_ip(i), probe_sport(i), probe_port(i), probe_seq(i));
+    });
+    double fast = measure("SynTemplate::build", [&](uint8_t* out, int i) {
+        tmpl.build(out, probe_ip(i), probe_sport(i), probe_port(i), probe_seq(i));
+    });
+    std::cout << "x" << fast / full << "\n";
+    return 0;
+}
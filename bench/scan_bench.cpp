@@ -0,0 +1,124 @@
+// Конкуренция воркеров Scanner: раздача проб и сбор результатов при разном
+// числе потоков. Сначала без сети — очередь и вектор под мьютексами (как было)
+// против атомарного курсора с пачками и буферов по потокам, затем полный
+// connect-скан 127.0.0.1:1-65535.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+#include "scanner.hpp"
+
+static double seconds_since(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+static uint64_t cpu_time_us() {
+    rusage ru{};
+    getrusage(RUSAGE_SELF, &ru);
+    return (uint64_t)(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000 +
+           ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+}
+
+// Каждая сотая проба «открыта» и уходит в результаты
+static constexpr int kProbes = 4000000;
+static constexpr int kOpenEvery = 100;
+
+static double run_locked(int threads) {
+    std::queue<int> queue;
+    for (int i = 0; i < kProbes; i++) queue.push(i);
+    std::mutex queue_mtx, results_mtx;
+    std::vector<int> results;
+
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&] {
+            while (true) {
+                int probe;
+                {
+                    std::lock_guard<std::mutex> lock(queue_mtx);
+                    if (queue.empty()) return;
+                    probe = queue.front();
+                    queue.pop();
+                }
+                if (probe % kOpenEvery == 0) {
+                    std::lock_guard<std::mutex> lock(results_mtx);
+                    results.push_back(probe);
+                }
+            }
+        });
+    }
+    for (auto& w : workers) w.join();
+    return seconds_since(t0);
+}
+
+static double run_cursor(int threads) {
+    constexpr uint64_t chunk = 64;
+    std::atomic<uint64_t> cursor{0};
+    struct alignas(64) Buffer {
+        std::vector<int> items;
+    };
+    std::vector<Buffer> buffers(threads);
+
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t] {
+            auto& out = buffers[t].items;
+            while (true) {
+                uint64_t k = cursor.fetch_add(chunk, std::memory_order_relaxed);
+                if (k >= (uint64_t)kProbes) return;
+                uint64_t end = std::min<uint64_t>(kProbes, k + chunk);
+                for (; k < end; k++) {
+                    if (k % kOpenEvery == 0) out.push_back((int)k);
+                }
+            }
+        });
+    }
+    for (auto& w : workers) w.join();
+    std::vector<int> results;
+    for (auto& b : buffers) results.insert(results.end(), b.items.begin(), b.items.end());
+    return seconds_since(t0);
+}
+
+int main() {
+    const int sweep[] = {1, 2, 4, 8, 32, 128, 500};
+
+    std::cout << "distribution only, " << kProbes << " probes:\n";
+    for (int threads : sweep) {
+        double locked = run_locked(threads);
+        double cursor = run_cursor(threads);
+        std::cout << "  " << threads << " threads: mutex queue "
+                  << (uint64_t)(kProbes / locked) << "/s, chunked cursor "
+                  << (uint64_t)(kProbes / cursor) << "/s\n";
+    }
+
+    TargetSet targets;
+    std::string err;
+    targets.add("127.0.0.1", err);
+    PortSet ports;
+    ports.add_range(1, 65535);
+
+    std::cout << "connect scan 127.0.0.1:1-65535:\n";
+    for (int threads : sweep) {
+        ScanOptions opts;
+        opts.threads = threads;
+        opts.max_inflight = std::max(1, 4096 / threads);
+        opts.retries = 0;
+        Scanner scanner("127.0.0.1", targets, ports, PortSet(), opts);
+        auto t0 = std::chrono::steady_clock::now();
+        uint64_t cpu0 = cpu_time_us();
+        uint64_t open_ports = scanner.run();
+        uint64_t cpu_us = cpu_time_us() - cpu0;
+        double secs = seconds_since(t0);
+        std::cout << "  " << threads << " threads: " << (uint64_t)(ports.count() / secs)
+                  << " probes/s, " << (double)cpu_us / ports.count() << " us CPU/probe, open="
+                  << open_ports << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,58 @@
+// Колесо таймеров против двоичной кучи на миллионах проб в полёте:
+// вставка N таймеров со случайными таймаутами и срабатывание всех по времени.
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "timing_wheel.hpp"
+
+struct Timer {
+    uint64_t at_ms;
+    uint64_t payload;
+    bool operator>(const Timer& o) const { return at_ms > o.at_ms; }
+};
+
+static double seconds_since(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+int main() {
+    for (size_t n : {1000000, 4000000}) {
+        std::mt19937_64 rng(42);
+        std::vector<uint64_t> timeouts(n);
+        for (auto& t : timeouts) t = 50 + rng() % 3000;
+        const uint64_t start = 1000000;
+
+        // --- Колесо ---
+        auto t0 = std::chrono::steady_clock::now();
+        TimingWheel wheel(start);
+        for (size_t i = 0; i < n; ++i) wheel.add(start + timeouts[i], i);
+        uint64_t fired = 0;
+        for (uint64_t now = start; !wheel.empty(); ++now) {
+            wheel.advance(now, [&](uint64_t) { ++fired; });
+        }
+        double wheel_s = seconds_since(t0);
+
+        // --- Куча ---
+        t0 = std::chrono::steady_clock::now();
+        std::vector<Timer> heap;
+        heap.reserve(n);
+        for (size_t i = 0; i < n; ++i) {
+            heap.push_back({start + timeouts[i], i});
+            std::push_heap(heap.begin(), heap.end(), std::greater<Timer>());
+        }
+        uint64_t popped = 0;
+        while (!heap.empty()) {
+            std::pop_heap(heap.begin(), heap.end(), std::greater<Timer>());
+            heap.pop_back();
+            ++popped;
+        }
+        double heap_s = seconds_since(t0);
+
+        std::cout << n << " timers: wheel " << (uint64_t)(2 * n / wheel_s) << " ops/s, heap "
+                  << (uint64_t)(2 * n / heap_s) << " ops/s (" << fired << "/" << popped << ")\n";
+    }
+    return 0;
+}
@@ -1,5 +1,30 @@
 #pragma once
+#include <cstdint>
 #include <string>
+#include <string_view>
 
-bool tcp_connect_with_timeout(const std::string& ip, int port, int timeout_ms, int& out_sock);
-std::string try_grab_banner(int sock, int port, int timeout_ms);
+// Пробы для banner grabbing. На порт приходится упорядоченный список проб:
+// сначала те, у которых порт в подсказке, затем общие (без подсказки), не
+// больше kMaxProbesPerPort. Каждая проба сначала слушает приветствие
+// greeting_ms (SSH/SMTP/FTP говорят первыми), потом шлёт payload и ждёт ответ
+// не дольше таймаута баннера. Первый непустой ответ завершает перебор.
+// Ответ TLS-пробы не копируется как есть, а разбирается (tls_probe.hpp).
+enum class ProbeKind : uint8_t { RAW, TLS };
+
+struct BannerProbe {
+    const char* name;
+    std::string_view payload;  // пусто — NULL-проба: только слушаем
+    const char* ports;         // подсказка в синтаксисе -p; nullptr — любой порт
+    int greeting_ms;           // kGreetFull — весь таймаут баннера
+    ProbeKind kind = ProbeKind::RAW;
+};
+
+const int kGreetFull = -1;
+const size_t kMaxProbesPerPort = 3;
+const size_t kMaxBannerLen = 200;
+
+// step-я проба для порта; nullptr — пробы кончились
+const BannerProbe* banner_probe(uint16_t port, unsigned step);
+
+// Дописывает принятые байты к баннеру, обрезая его до kMaxBannerLen
+void append_banner(std::string& banner, const char* data, long n);
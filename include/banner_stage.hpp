@@ -0,0 +1,50 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "probe.hpp"
+#include "rtt.hpp"
+
+// Стадия снятия баннеров, отделённая от поиска портов: найденные открытые
+// порты попадают в ограниченную очередь, а свой поток с отдельным
+// ConnectEngine открывает к ним новые соединения и читает баннеры. Бюджет
+// соединений и таймаут у стадии свои, так что медленные и болтливые сервисы
+// не занимают слоты поиска; годится и для connect-, и для SYN-скана.
+class BannerStage {
+public:
+    // Зовётся из потока стадии; banner пуст, если сервис ничего не сказал
+    // или повторное соединение не удалось
+    using DoneFn = std::function<void(const ProbeTask&, const std::string& banner)>;
+
+    BannerStage(int max_inflight, int timeout_ms, RttEstimator& rtt, int retries,
+                size_t queue_limit);
+    ~BannerStage();
+    BannerStage(const BannerStage&) = delete;
+    BannerStage& operator=(const BannerStage&) = delete;
+
+    void start(DoneFn done);
+    // Ждёт, если очередь заполнена
+    void push(const ProbeTask& task);
+    // Закрывает вход, дожидается всех баннеров и останавливает поток
+    void finish();
+
+private:
+    int max_inflight;
+    int timeout_ms;
+    RttEstimator& rtt;
+    int retries;
+    size_t queue_limit;
+
+    std::mutex mtx;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    std::deque<ProbeTask> queue;
+    bool closed = false;
+    std::thread thread;
+
+    bool next(ProbeTask& task);
+    bool wait_more(int timeout_ms);
+};
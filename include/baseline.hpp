@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "ports.hpp"
+#include "scanner.hpp"
+
+// Прошлый результат для --baseline: открытые порты по хостам (TCP и UDP —
+// в отдельных HostPorts) и то, что о них было известно, — баннер и опознание
+// сервиса, если они были. Читается .scnr (через mmap, без разбора строк) или
+// JSON/NDJSON этого же сканера; закрытые записи (open:false) пропускаются.
+class Baseline {
+public:
+    struct Entry {
+        std::string banner;
+        ServiceInfo service;
+    };
+
+    // false + err — файла нет или он не в одном из наших форматов
+    bool load(const std::string& path, std::string& err);
+
+    // Ключ пары: порядок ключей — по адресу, порту, затем TCP раньше UDP
+    static uint64_t key(uint32_t ip, uint16_t port, Proto proto) {
+        return ((uint64_t)ip << 17) | ((uint64_t)port << 1) | (proto == Proto::UDP ? 1 : 0);
+    }
+    static uint32_t key_ip(uint64_t k) { return (uint32_t)(k >> 17); }
+    static uint16_t key_port(uint64_t k) { return (uint16_t)(k >> 1); }
+    static Proto key_proto(uint64_t k) { return k & 1 ? Proto::UDP : Proto::TCP; }
+
+    bool contains(uint32_t ip, uint16_t port, Proto proto) const {
+        return (proto == Proto::UDP ? udp : tcp).contains(ip, port);
+    }
+    // Баннер и сервис из прошлого скана; nullptr — не снимались или пусты
+    const Entry* entry(uint32_t ip, uint16_t port, Proto proto) const;
+    size_t size() const { return tcp.size() + udp.size(); }
+
+    // fn(ip, port, proto) по возрастанию адреса и порта, TCP раньше UDP
+    template <typename Fn>
+    void for_each(Fn fn) const {
+        tcp.for_each([&](uint32_t ip, uint16_t port) { fn(ip, port, Proto::TCP); });
+        udp.for_each([&](uint32_t ip, uint16_t port) { fn(ip, port, Proto::UDP); });
+    }
+
+private:
+    HostPorts tcp;
+    HostPorts udp;
+    std::unordered_map<uint64_t, Entry> entries;
+
+    void add(uint32_t ip, uint16_t port, Proto proto, Entry e);
+    bool load_binary(const std::string& path, std::string& err);
+    bool load_json(const std::string& path, std::string& err);
+};
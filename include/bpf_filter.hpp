@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+
+#ifdef __linux__
+// Фильтр ответов прямо в ядре: на сокет приёма вешается программа, которая
+// пропускает только TCP SYN-ACK/RST от целей на наш диапазон портов источника.
+// Остальной трафик хоста не доходит до userspace вовсе.
+class ReplyFilter {
+public:
+    struct Spec {
+        uint32_t local_ip;          // наш адрес (host byte order)
+        uint32_t first_ip;          // диапазон адресов целей, включительно
+        uint32_t last_ip;
+        uint16_t first_port;        // диапазон портов источника SYN
+        uint16_t last_port;
+    };
+
+    ReplyFilter() = default;
+    ~ReplyFilter();
+    ReplyFilter(const ReplyFilter&) = delete;
+    ReplyFilter& operator=(const ReplyFilter&) = delete;
+
+    // Сокет должен отдавать фильтру пакет с IP-заголовка (raw IPPROTO_TCP или
+    // AF_PACKET SOCK_DGRAM). Сначала пробует eBPF со счётчиком отброшенного,
+    // иначе classic BPF через SO_ATTACH_FILTER.
+    bool attach(int fd, const Spec& spec);
+
+    // Счётчик есть только у eBPF-варианта
+    bool counting() const { return map_fd >= 0; }
+    uint64_t filtered() const;
+
+private:
+    int prog_fd = -1;
+    int map_fd = -1;
+
+    bool attach_ebpf(int fd, const Spec& spec);
+    bool attach_classic(int fd, const Spec& spec);
+};
+#endif
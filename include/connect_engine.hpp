@@ -0,0 +1,87 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "probe.hpp"
+#include "rate_controller.hpp"
+#include "rtt.hpp"
+#include "timing_wheel.hpp"
+#include "tls_probe.hpp"
+
+// Асинхронный connect-движок: тысячи неблокирующих сокетов на одном epoll
+// (poll() вне Linux), у каждого сокета свой дедлайн — из RTT его хоста, — и все
+// дедлайны в одном колесе таймеров. Проба без ответа повторяется до retries раз.
+// Баннер тоже снимается внутри цикла неблокирующими send/recv по таблице проб
+// (banner.hpp), так что медленный сервис не тормозит остальные пробы.
+class ConnectEngine {
+public:
+    using DoneFn = std::function<void(const ProbeTask&, bool open, const std::string& banner)>;
+    // Ждёт новые пробы не дольше timeout_ms; false — входа больше не будет
+    using WaitFn = std::function<bool(int timeout_ms)>;
+
+    // rtt даёт таймаут connect для хоста и получает замер от каждого SYN-ACK/RST
+    ConnectEngine(int max_inflight, RttEstimator& rtt, int retries, bool grab_banner,
+                  int banner_timeout_ms);
+    ~ConnectEngine();
+
+    // Без wait_more false из next() означает конец входа. С ним — только «пока
+    // пусто» (очередь другой стадии): движок переспрашивает next() не реже раза в
+    // kInputPollMs, а без проб в полёте ждёт в wait_more, пока тот не вернёт false
+    void run(const NextProbeFn& next, const DoneFn& done, const WaitFn& wait_more = nullptr);
+
+    // connect (и повторы) — в темпе rate; ему же идут ответы
+    void pace_with(RateController* r) { rate = r; }
+
+private:
+    static constexpr int kInputPollMs = 5;
+    // Токенов, которые движок берёт у RateController за раз
+    static constexpr size_t kRateChunk = 16;
+
+    // GREETING — слушаем приветствие, RESPONSE — проба отправлена, ждём ответ
+    enum class Stage : uint8_t { IDLE, CONNECT, GREETING, RESPONSE };
+
+    struct Slot {
+        int fd = -1;
+        uint32_t gen = 0;
+        Stage stage = Stage::IDLE;
+        uint8_t attempt = 0;
+        uint8_t probe = 0;     // шаг в списке проб баннера для порта
+        ProbeTask task{};
+        uint64_t started_us = 0;
+        std::string banner;
+        std::unique_ptr<TlsReader> tls;  // ответ TLS-пробы, пока он приходит
+    };
+    struct Retry {
+        ProbeTask task;
+        uint8_t attempt;
+        uint8_t probe;
+    };
+
+    int max_inflight;
+    RttEstimator& rtt;
+    int retries;
+    bool grab_banner;
+    int banner_timeout_ms;
+    int poll_fd = -1;
+    RateController* rate = nullptr;
+    size_t credit = 0;  // взятые, но ещё не потраченные токены
+
+    std::vector<Slot> slots;
+    std::vector<uint32_t> free_slots;
+    // Дедлайны обеих стадий; payload — (gen << 32) | slot
+    TimingWheel timers;
+    // Пробы, оставшиеся без ответа и ждущие повтора; идут раньше новых
+    std::vector<Retry> retry_queue;
+
+    bool start(const Retry& r, const DoneFn& done, bool& fd_exhausted);
+    void on_connected(uint32_t slot, const DoneFn& done);
+    void send_probe(uint32_t slot, const DoneFn& done);
+    void next_probe(uint32_t slot, const DoneFn& done);
+    void on_readable(uint32_t slot, const DoneFn& done);
+    void on_tls(uint32_t slot, const char* data, long n, const DoneFn& done);
+    void expire(uint64_t payload, const DoneFn& done);
+    void finish(uint32_t slot, bool open, const DoneFn& done);
+    void release(uint32_t slot);
+};
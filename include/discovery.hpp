@@ -0,0 +1,115 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <sys/socket.h>
+#include "targets.hpp"
+#include "rate_controller.hpp"
+#include "rtt.hpp"
+
+#ifdef __linux__
+// Поиск живых хостов перед сканом портов (--discover), как host discovery у
+// nmap/masscan. Цели в подсети одного из своих интерфейсов спрашиваются ARP —
+// на ARP отвечает любой включённый хост, даже если файрвол режет весь IP.
+// Остальным уходит ICMP echo, SYN на 22/80/443/3389 и ACK на 80: живым
+// считается хост, приславший echo reply, любой TCP-ответ (SYN-ACK или RST)
+// или ICMP unreachable от своего имени (а не от маршрутизатора).
+//
+// Пакеты собираются пачками и уходят через sendmmsg с raw-сокетов (нужен root),
+// в темпе общего RateController, если задан --rate. Всё в одном потоке:
+// между пачками разбираются ответы, после каждого прохода — ожидание wait_ms.
+// Повторный проход шлёт пробы только хостам, ещё не ответившим.
+class HostDiscovery {
+public:
+    struct Stats {
+        uint64_t by_arp = 0;        // хостов, ответивших на ARP
+        uint64_t by_icmp = 0;       // первым ответом был ICMP (echo reply, unreachable)
+        uint64_t by_tcp = 0;        // первым ответом был SYN-ACK или RST
+        uint64_t send_failures = 0;
+        int last_error = 0;
+    };
+
+    // rounds — проходов по хостам без ответа; seed — порядок обхода
+    HostDiscovery(const TargetSet& targets, RttEstimator& rtt, int rounds, int wait_ms,
+                  uint64_t seed);
+    ~HostDiscovery();
+
+    // Открывает raw-сокеты (нужен root); false — errno от неудавшегося socket()
+    bool open();
+    void pace_with(RateController* r) { rate = r; }
+    // Живые хосты из targets
+    TargetSet run();
+
+    uint64_t alive() const { return alive_count; }
+    const Stats& stats() const { return discovery_stats; }
+
+private:
+    // Токенов, которые берутся у RateController за раз
+    static constexpr size_t kRateChunk = 16;
+
+    // Свой интерфейс с IPv4-подсетью и MAC — для ARP
+    struct Link {
+        uint32_t ip;      // host byte order
+        uint32_t mask;
+        int ifindex;
+        uint8_t mac[6];
+    };
+
+    // Пачка пакетов одного сокета для sendmmsg
+    struct Batch {
+        int fd = -1;
+        size_t packet_len = 0;
+        int n = 0;
+        std::vector<uint8_t> packets;
+        std::vector<sockaddr_storage> dsts;
+        std::vector<iovec> iovs;
+        std::vector<mmsghdr> msgs;
+
+        void init(int fd, size_t packet_len);
+    };
+
+    const TargetSet& targets;
+    RttEstimator& rtt;
+    int rounds;
+    int wait_ms;
+    uint64_t seed;
+    uint32_t src_ip = 0;     // источник TCP-пингов, host byte order
+    uint16_t echo_id = 0;
+    uint16_t sport = 0;      // порт источника TCP-пингов
+    uint32_t key = 0;        // ключ seq у TCP-пингов
+    int icmp_fd = -1;        // echo туда и ICMP обратно
+    int raw_fd = -1;         // TCP-пинги (IPPROTO_RAW)
+    int tcp_fd = -1;         // ответы на TCP-пинги
+    int arp_fd = -1;         // AF_PACKET, ARP
+    std::vector<Link> links;
+    std::vector<uint64_t> bits;  // живые хосты по номеру в targets
+    uint64_t alive_count = 0;
+    RateController* rate = nullptr;
+    size_t credit = 0;
+    Stats discovery_stats;
+
+    Batch icmp_batch;
+    Batch tcp_batch;
+    Batch arp_batch;
+
+    const Link* link_for(uint32_t ip) const;
+    uint32_t cookie(uint32_t ip) const;
+    bool is_alive(uint64_t index) const { return bits[index / 64] >> (index % 64) & 1; }
+    // Ответ от ip; true — хост раньше не отвечал
+    bool mark(uint32_t ip);
+
+    void probe(uint32_t ip);
+    void queue_echo(uint32_t ip);
+    void queue_tcp(uint32_t ip, uint16_t port, uint8_t flags);
+    void queue_arp(const Link& link, uint32_t ip);
+    uint8_t* slot(Batch& b, const void* dst, socklen_t len);
+    void flush(Batch& b);
+    void flush_all();
+    // Ждёт токен общего темпа, разбирая ответы
+    void pace();
+
+    void poll_replies(int timeout_ms);
+    void drain_icmp();
+    void drain_tcp();
+    void drain_arp();
+};
+#endif
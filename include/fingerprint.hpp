@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Что опознано по баннеру; пустой service — сигнатуры не подошли
+struct ServiceInfo {
+    std::string service;
+    std::string product;
+    std::string version;
+};
+
+// Опознание сервисов по баннерам. Файл сигнатур — по правилу на строку:
+//
+//   service  product  /regex/flags
+//
+// product — слово, "строка в кавычках" или - (неизвестен), флаг i — без учёта
+// регистра, первая группа regex (если совпала) — версия. Правила проверяются
+// по порядку, побеждает первое подошедшее.
+//
+// Из каждого regex при компиляции берётся обязательный литерал, и все
+// литералы собираются в один автомат Ахо-Корасик (без учёта регистра):
+// баннер проходит через него за один проход, а regex проверяются только у
+// правил, чей литерал нашёлся (и у правил без литерала).
+class Fingerprints {
+public:
+    // Встроенный набор сигнатур
+    bool load_builtin(std::string& err);
+    bool load_file(const std::string& path, std::string& err);
+    // Текст в формате файла сигнатур; name — для сообщений об ошибках
+    bool compile(std::string_view text, const std::string& name, std::string& err);
+
+    // false — ни одна сигнатура не подошла (out не тронут)
+    bool match(std::string_view banner, ServiceInfo& out) const;
+    size_t size() const { return rules.size(); }
+
+private:
+    static constexpr size_t kMinLiteral = 3;  // короче — правило проверяется всегда
+
+    struct Rule {
+        std::string service;
+        std::string product;
+        std::regex re;
+        bool anchored;  // regex начинается с ^ — пробуем только с начала баннера
+    };
+    std::vector<Rule> rules;
+    // Правила без пригодного литерала, по возрастанию номера
+    std::vector<uint32_t> always;
+
+    // --- Автомат: DFA по классам байтов ---
+    // Байты, не встречающиеся в литералах, — класс 0; заглавная буква — в классе строчной
+    uint8_t byte_class[256] = {};
+    uint32_t class_count = 1;
+    std::vector<uint32_t> delta;       // state * class_count + class -> state
+    std::vector<uint32_t> out_begin;   // правила состояния: out_rules[out_begin[s], out_begin[s + 1])
+    std::vector<uint32_t> out_rules;
+
+    void build(const std::vector<std::string>& literals);
+};
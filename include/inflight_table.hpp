@@ -0,0 +1,59 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#ifdef __linux__
+// Таблица проб в полёте для SYN-движка: открытая адресация с линейным
+// пробированием в одном заранее выделенном массиве (по возможности на huge
+// pages), без аллокаций по ходу скана. Ключ — (ip, port); порт источника
+// однозначно выводится из них, поэтому в ключ не входит.
+//
+// Писатель один — поток отправки: вставляет, обновляет попытку и удаляет
+// (обратным сдвигом, без надгробий). Поток приёма только помечает пробу
+// отвеченной — CAS по слову, где лежат и ключ, и флаги, так что пометка не
+// может попасть в чужую запись. Если пометка разминулась с переносом записи при
+// удалении, проба просто будет повторена — результат от этого не теряется.
+class InflightTable {
+public:
+    explicit InflightTable(size_t max_entries);
+    ~InflightTable();
+    InflightTable(const InflightTable&) = delete;
+    InflightTable& operator=(const InflightTable&) = delete;
+
+    size_t capacity() const { return max_entries; }
+    size_t size() const { return live; }
+    bool full() const { return live >= max_entries; }
+    bool huge_pages() const { return hugetlb; }
+
+    // --- Поток отправки ---
+    bool insert(uint32_t ip, uint16_t port, uint64_t sent_us);
+    // false — пробы нет; иначе её попытка и отвечена ли она
+    bool lookup(uint32_t ip, uint16_t port, uint8_t& attempt, bool& answered) const;
+    // Повтор: новая попытка и время отправки; false — проба уже отвечена
+    bool retry(uint32_t ip, uint16_t port, uint8_t attempt, uint64_t sent_us);
+    void erase(uint32_t ip, uint16_t port);
+
+    // --- Поток приёма (без блокировок) ---
+    // true — проба найдена и помечена этим вызовом; attempt/sent_us — её текущая попытка
+    bool mark_answered(uint32_t ip, uint16_t port, uint8_t& attempt, uint64_t& sent_us);
+
+private:
+    // Слово записи: ip (32) | port (16) | attempt (8) | флаги (8); 0 — пусто
+    struct Entry {
+        std::atomic<uint64_t> word;
+        std::atomic<uint64_t> sent_us;
+    };
+
+    Entry* table = nullptr;
+    size_t mask = 0;
+    size_t bytes = 0;
+    size_t max_entries;
+    size_t live = 0;
+    bool hugetlb = false;
+
+    size_t home(uint64_t key) const;
+    // Номер ячейки с ключом или SIZE_MAX
+    size_t find(uint64_t key) const;
+};
+#endif
@@ -1,9 +1,74 @@
 #pragma once
+#include <cstdint>
+#include <cstdio>
 #include <string>
-#include <vector>
+#include <string_view>
 #include "scanner.hpp"
+#include "baseline.hpp"
 
+// Сериализация результатов в JSON без iostream и временных строк: всё
+// дописывается в конец переданного буфера, который вызывающий переиспользует
+// (clear() сохраняет ёмкость). Экранирование ищет спецсимволы векторно
+// (SSE2, AVX2 — если есть у процессора) и копирует чистые куски через memcpy.
 namespace JsonWriter {
-    std::string to_json(const std::string& target, const std::vector<ScanResult>& results);
-    bool save_to_file(const std::string& filename, const std::string& json_data);
+    // Содержимое строки JSON без кавычек: ", \ и управляющие символы экранируются,
+    // остальные байты (включая не-ASCII) копируются как есть
+    void escape(std::string& out, const char* s, size_t n);
+    inline void escape(std::string& out, std::string_view s) { escape(out, s.data(), s.size()); }
+
+    // "..." — строка в кавычках
+    void append_string(std::string& out, std::string_view s);
+    void append_uint(std::string& out, uint64_t v);
+    // a.b.c.d и "a.b.c.d" — адрес в host byte order
+    void append_dotted(std::string& out, uint32_t ip);
+    void append_ip(std::string& out, uint32_t ip);
+    // Микросекунды как миллисекунды с тремя знаками: 1234 -> 1.234
+    void append_ms(std::string& out, uint64_t us);
+
+    // {"ip":"...","port":N,"open":true,"banner":"..."}; UDP добавляет "proto":"udp",
+    // непустой service — "service" и непустые "product"/"version", ts_ms != 0 — "ts"
+    void append_result(std::string& out, uint32_t ip, uint16_t port, Proto proto, bool open,
+                       std::string_view banner, std::string_view service = {},
+                       std::string_view product = {}, std::string_view version = {},
+                       uint64_t ts_ms = 0);
+    inline void append_result(std::string& out, const ScanResult& r, uint64_t ts_ms = 0) {
+        append_result(out, r.ip, (uint16_t)r.port, r.proto, r.open, r.banner, r.service.service,
+                      r.service.product, r.service.version, ts_ms);
+    }
+    // {"change":"opened|closed|changed","ip":"...","port":N[,"proto":"udp"]} и дальше,
+    // у открытого r, — "banner" и сервис, как в append_result; непустой was — прошлые
+    // баннер и сервис в "was":{...}
+    void append_change(std::string& out, std::string_view kind, const ScanResult& r,
+                       const Baseline::Entry* was);
+    // {"ip":"...","srtt_ms":...,"rttvar_ms":...,"timeout_ms":N,"samples":N}
+    void append_host(std::string& out, uint32_t ip, uint32_t srtt_us, uint32_t rttvar_us,
+                     uint32_t timeout_ms, uint32_t samples);
+
+    // Документ results.json: begin(), result()..., hosts(), host()..., end().
+    // Копится в буфере и сбрасывается в файл кусками по ~1 МиБ; файл не закрывает
+    class Document {
+    public:
+        explicit Document(FILE* f);
+        void begin(std::string_view target);
+        void result(uint32_t ip, uint16_t port, Proto proto, bool open, std::string_view banner,
+                    std::string_view service = {}, std::string_view product = {},
+                    std::string_view version = {});
+        void hosts();
+        void host(uint32_t ip, uint32_t srtt_us, uint32_t rttvar_us, uint32_t timeout_ms,
+                  uint32_t samples);
+        void end();
+
+        // Отчёт --baseline: begin_diff(), change()..., end_diff()
+        void begin_diff(std::string_view target, std::string_view baseline);
+        void change(std::string_view kind, const ScanResult& r, const Baseline::Entry* was);
+        void end_diff(const DiffSummary& s);
+
+    private:
+        FILE* f;
+        std::string buf;
+        bool first = true;
+
+        void item();
+        void spill(bool force);
+    };
 }
@@ -0,0 +1,58 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "scanner.hpp"
+
+// Потоковый вывод NDJSON: по строке на находку, пишет отдельный поток.
+// Воркеры кладут результат в ограниченную очередь (при заполнении ждут),
+// поток записи копит строки в буфере и сбрасывает его в файл, открытый с
+// O_APPEND, не реже раза в kFlushMs, а fsync делает раз в kFsyncMs — так
+// память не растёт с размером скана, а при падении теряется не больше секунды.
+class NdjsonWriter {
+public:
+    NdjsonWriter() = default;
+    ~NdjsonWriter();
+    NdjsonWriter(const NdjsonWriter&) = delete;
+    NdjsonWriter& operator=(const NdjsonWriter&) = delete;
+
+    // Файл дописывается, а не перезаписывается
+    bool open(const std::string& path);
+    void push(const ScanResult& r);
+    // Ждёт, пока всё, что отдано push() до вызова, окажется в файле после fsync
+    void sync();
+    // Дописывает очередь, делает fsync и останавливает поток;
+    // false — была ошибка записи (подробности уже в stderr)
+    bool close();
+
+    uint64_t records() const { return written; }
+
+private:
+    static constexpr size_t kQueueLimit = 1 << 16;
+    static constexpr size_t kBufferBytes = 1 << 20;
+    static constexpr int kFlushMs = 200;
+    static constexpr int kFsyncMs = 1000;
+
+    int fd = -1;
+    std::thread thread;
+    std::mutex mtx;
+    std::condition_variable ready;   // в очереди есть записи или пора закрываться
+    std::condition_variable space;   // очередь разобрана
+    std::condition_variable synced;  // sync_done догнал sync_wanted
+    std::vector<ScanResult> queue;
+    bool closing = false;
+    uint64_t sync_wanted = 0;
+    uint64_t sync_done = 0;
+
+    // Дальше — только поток записи (written читается после join)
+    std::string buffer;
+    uint64_t written = 0;
+    bool failed = false;
+
+    void loop();
+    void append(const ScanResult& r);
+    void flush();
+};
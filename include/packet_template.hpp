@@ -0,0 +1,33 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#ifdef __linux__
+// Размер SYN-пакета: IP (20) + TCP (20) без опций
+const size_t kSynPacketLen = 40;
+
+// Флаги TCP для шаблона: SYN для скана, ACK — для пинга при поиске хостов
+const uint8_t kTcpSyn = 0x02;
+const uint8_t kTcpAck = 0x10;
+
+// Полная сборка SYN (или пакета с другими флагами) с подсчётом чексуммы по
+// псевдозаголовку — эталон для SynTemplate и микробенчмарка. Адреса и порты
+// в host byte order.
+void build_syn_packet(uint8_t* out, uint32_t src, uint32_t dst,
+                      uint16_t sport, uint16_t dport, uint32_t seq, uint8_t flags = kTcpSyn);
+
+// Шаблон SYN-пакета: заголовки и чексуммы считаются один раз на скан
+// (с нулевыми daddr/портами/seq), на пробу патчатся только эти поля, а
+// чексуммы обновляются инкрементально по RFC 1624.
+class SynTemplate {
+public:
+    explicit SynTemplate(uint32_t src_ip, uint8_t flags = kTcpSyn);
+
+    void build(uint8_t* out, uint32_t dst, uint16_t sport, uint16_t dport, uint32_t seq) const;
+
+private:
+    uint8_t base[kSynPacketLen];
+    uint16_t ip_check;   // ~sum IP-заголовка при daddr = 0
+    uint16_t tcp_check;  // ~sum TCP + псевдозаголовка при daddr/портах/seq = 0
+};
+#endif
@@ -0,0 +1,24 @@
+#pragma once
+#include <cstdint>
+
+// Случайная биекция [0, n) -> [0, n) за O(1) памяти: 4-раундовая сеть Фейстеля
+// на ближайшем сверху чётном числе бит + cycle-walking до попадания в [0, n).
+// Домен меньше 4n, поэтому в среднем хватает меньше четырёх шифрований.
+class Permutation {
+public:
+    Permutation(uint64_t n, uint64_t seed);
+
+    uint64_t size() const { return n; }
+    uint64_t at(uint64_t index) const;
+    // Обратное отображение: at(index_of(v)) == v
+    uint64_t index_of(uint64_t value) const;
+
+private:
+    uint64_t n;
+    unsigned half_bits = 1;
+    uint64_t half_mask = 1;
+    uint64_t keys[4];
+
+    uint64_t encrypt(uint64_t x) const;
+    uint64_t decrypt(uint64_t x) const;
+};
@@ -0,0 +1,121 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Множество TCP-портов: битовая карта на все 65536 значений (8 КиБ).
+// Диапазоны ставятся и снимаются целыми 64-битными словами, обход идёт по
+// установленным битам через ctz, так что пустые участки почти ничего не стоят.
+class PortSet {
+public:
+    static constexpr size_t kWords = 65536 / 64;
+
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = uint16_t;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const uint16_t*;
+        using reference = uint16_t;
+
+        uint16_t operator*() const { return (uint16_t)(word * 64 + __builtin_ctzll(bits)); }
+        const_iterator& operator++() {
+            bits &= bits - 1;
+            settle();
+            return *this;
+        }
+        bool operator==(const const_iterator& o) const { return word == o.word && bits == o.bits; }
+        bool operator!=(const const_iterator& o) const { return !(*this == o); }
+
+    private:
+        friend class PortSet;
+        const uint64_t* words;
+        size_t word;
+        uint64_t bits;
+
+        const_iterator(const uint64_t* words, size_t word)
+            : words(words), word(word), bits(word < kWords ? words[word] : 0) { settle(); }
+        // Перейти к ближайшему непустому слову
+        void settle() {
+            while (!bits && ++word < kWords) bits = words[word];
+            if (!bits) word = kWords;
+        }
+    };
+
+    void add(uint16_t port) { bits[port >> 6] |= 1ull << (port & 63); }
+    void remove(uint16_t port) { bits[port >> 6] &= ~(1ull << (port & 63)); }
+    bool contains(uint16_t port) const { return bits[port >> 6] >> (port & 63) & 1; }
+    // [lo, hi] включительно
+    void add_range(uint16_t lo, uint16_t hi);
+    void remove_range(uint16_t lo, uint16_t hi);
+
+    PortSet& operator|=(const PortSet& o);
+    // Разность: убрать порты o
+    PortSet& operator-=(const PortSet& o);
+
+    size_t count() const;
+    bool empty() const;
+    const_iterator begin() const { return const_iterator(bits, 0); }
+    const_iterator end() const { return const_iterator(bits, kWords); }
+    std::vector<uint16_t> to_vector() const;
+    // Те же порты по убыванию вероятности быть открытыми (встроенная таблица
+    // частот для TCP или UDP, за ней прочие по возрастанию); tiers — концы ярусов
+    // близкой частоты в результате: первые 10, до 100, остаток таблицы, остальное
+    std::vector<uint16_t> by_frequency(bool udp, std::vector<size_t>& tiers) const;
+
+    // Спецификация -p через запятую: 80, 1-1024, -1024 (от 1), 60000- (до 65535),
+    // именованные top100/top1000 (самые частые порты по nmap-services), и всё
+    // это с ! для исключения: "1-65535,!25", "top1000,!top100". Исключения
+    // применяются после объединения; если есть только они — к 1-65535.
+    static bool parse(const std::string& spec, PortSet& out, std::string& err);
+
+private:
+    uint64_t bits[kWords] = {};
+};
+
+// Открытые порты по хостам — без повторов и без ScanResult на каждую находку.
+// У хоста сначала отсортированный массив портов, а после kDenseAt портов — битовая
+// карта PortSet: так хост стоит не больше 8 КиБ при полном диапазоне и пару байт
+// на порт, когда открытых мало.
+class HostPorts {
+public:
+    // false — пара уже была
+    bool insert(uint32_t ip, uint16_t port);
+    bool contains(uint32_t ip, uint16_t port) const;
+    size_t size() const { return total; }
+
+    // fn(ip, port) по возрастанию адреса, затем порта
+    template <typename Fn>
+    void for_each(Fn fn) const {
+        std::vector<uint32_t> ips;
+        ips.reserve(hosts.size());
+        for (const auto& h : hosts) ips.push_back(h.first);
+        std::sort(ips.begin(), ips.end());
+        for (uint32_t ip : ips) {
+            const Host& h = hosts.at(ip);
+            if (h.dense) {
+                for (uint16_t port : *h.dense) fn(ip, port);
+            } else {
+                for (uint16_t port : h.sparse) fn(ip, port);
+            }
+        }
+    }
+
+private:
+    static constexpr size_t kDenseAt = 4096;  // 4096 * 2 байта = размер PortSet
+
+    struct Host {
+        std::vector<uint16_t> sparse;
+        std::unique_ptr<PortSet> dense;
+    };
+
+    std::unordered_map<uint32_t, Host> hosts;
+    size_t total = 0;
+    // Хост прошлой вставки; узлы unordered_map при росте таблицы не переезжают
+    Host* last = nullptr;
+    uint32_t last_ip = 0;
+};
@@ -0,0 +1,14 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+
+// Одна проба (адрес в host byte order)
+struct ProbeTask {
+    uint32_t ip;
+    uint16_t port;
+};
+
+// Источник проб для движков: false, когда задачи закончились
+using NextProbeFn = std::function<bool(ProbeTask&)>;
+// Проба исчерпала попытки, так и не получив ответа
+using ExpiredFn = std::function<void(const ProbeTask&)>;
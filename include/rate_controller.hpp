@@ -0,0 +1,77 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+// Темп отправки проб (--rate), общий на все движки поиска: ведро токенов,
+// скорость которого подстраивает AIMD.
+//
+// Ведро пополняется со скоростью rate() пакетов в секунду, запас — на kBurstMs.
+// Раз в окно (не короче kWindowMs и не меньше kMinSamples ответов) смотрим на
+// сигналы перегрузки: долю ответов, пришедших только на повтор (первая
+// попытка или ответ на неё потерялись), и потери в ядре — переполненное кольцо
+// приёма, ENOBUFS при отправке. Потери — скорость умножается на 1 - доля
+// опоздавших ответов (от kMaxDecrease до kDecrease), и сигналы kHoldMs не
+// учитываются (ответы на пробы, отправленные до снижения, ещё в пути); чистое
+// окно — прибавка max_pps / kIncreaseSteps, не выше --rate.
+// Пробы без ответа вообще сигналом не считаются: фильтруемый порт молчит при
+// любой скорости.
+class RateController {
+public:
+    struct Stats {
+        double max_pps;
+        double final_pps;
+        double min_pps;      // самая низкая скорость за скан
+        uint64_t decreases;  // сколько раз AIMD снижал скорость
+    };
+
+    explicit RateController(double max_pps);
+
+    // Сколько из want пакетов можно отправить сейчас (токены списываются)
+    size_t take(size_t want);
+    // Пакеты, отправленные без take() (повторы): токены уходят в минус
+    void charge(size_t n);
+    // Через сколько мс появится следующий токен; 0 — уже есть
+    int wait_ms();
+
+    // --- Сигналы; можно звать из любого потока без блокировок ---
+    // Ответ на пробу; attempt > 0 — пришёл только на повтор
+    void answered(unsigned attempt) {
+        answers.fetch_add(1, std::memory_order_relaxed);
+        if (attempt > 0) late.fetch_add(1, std::memory_order_relaxed);
+    }
+    void dropped(uint64_t n) { drops.fetch_add(n, std::memory_order_relaxed); }
+
+    double rate();
+    Stats stats();
+
+private:
+    static constexpr int kBurstMs = 10;
+    static constexpr int kWindowMs = 200;
+    static constexpr int kMaxWindowMs = 2000;  // дольше без ответов — окно без вывода
+    static constexpr uint64_t kMinSamples = 32;
+    static constexpr double kLossThreshold = 0.05;
+    static constexpr double kDecrease = 0.7;
+    static constexpr double kMaxDecrease = 0.5;
+    static constexpr int kIncreaseSteps = 20;
+    static constexpr int kHoldMs = 500;
+
+    std::mutex mtx;
+    double max_pps;
+    double min_pps;      // нижняя граница AIMD
+    double pps;
+    double tokens;
+    uint64_t refilled_us;
+    uint64_t window_start_us;
+    uint64_t hold_until_us = 0;
+    double lowest;
+    uint64_t cuts = 0;
+
+    std::atomic<uint64_t> answers{0};
+    std::atomic<uint64_t> late{0};
+    std::atomic<uint64_t> drops{0};
+
+    // Пополнение ведра и шаг AIMD; под mtx
+    void tick(uint64_t now_us);
+};
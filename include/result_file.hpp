@@ -0,0 +1,132 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "scanner.hpp"
+#include "rtt.hpp"
+
+// Двоичный формат результатов (.scnr), little-endian:
+//
+//   Header | PortRecord[record_count] | HostRecord[host_count] | пул строк
+//
+// Записи портов фиксированной ширины и ссылаются на хост по номеру в таблице
+// хостов; баннеры, опознание сервиса ("service\0product\0version") и строка
+// цели лежат в пуле, одинаковые строки — один раз.
+// Писатель дописывает записи портов сразу за заголовком по мере поступления,
+// а таблицу хостов, пул и итоговый заголовок пишет в finish(); файл без
+// finish() (скан упал) читатель отвергает по флагу kComplete.
+namespace ResultFormat {
+    constexpr char kMagic[4] = {'S', 'C', 'N', 'R'};
+    constexpr uint16_t kVersion = 2;  // 2 — опознание сервиса в PortRecord
+    constexpr uint16_t kComplete = 1;
+
+    struct Header {
+        char magic[4];
+        uint16_t version;
+        uint16_t flags;
+        uint64_t record_count;
+        uint64_t records_offset;
+        uint64_t host_count;
+        uint64_t hosts_offset;
+        uint64_t pool_offset;
+        uint64_t pool_size;
+        uint32_t target_offset;  // строка цели в пуле
+        uint32_t target_len;
+    };
+
+    struct HostRecord {
+        uint32_t ip;          // host byte order
+        uint32_t srtt_us;     // 0 — хост не отвечал
+        uint32_t rttvar_us;
+        uint32_t timeout_ms;
+        uint32_t samples;
+    };
+
+    struct PortRecord {
+        uint32_t host;        // номер в таблице хостов
+        uint16_t port;
+        uint8_t open;
+        uint8_t proto;        // Proto: 0 — TCP, 1 — UDP (в файлах без UDP всегда 0)
+        uint32_t banner_offset;
+        uint32_t banner_len;
+        uint32_t service_offset;  // service\0product\0version; 0 байт — не опознан
+        uint32_t service_len;
+    };
+
+    static_assert(sizeof(Header) == 64, "Header layout");
+    static_assert(sizeof(HostRecord) == 20, "HostRecord layout");
+    static_assert(sizeof(PortRecord) == 24, "PortRecord layout");
+}
+
+class ResultFileWriter {
+public:
+    ResultFileWriter() = default;
+    ~ResultFileWriter();
+    ResultFileWriter(const ResultFileWriter&) = delete;
+    ResultFileWriter& operator=(const ResultFileWriter&) = delete;
+
+    bool open(const std::string& path, const std::string& target);
+    void add(const ScanResult& r);
+    // RTT хоста; хост попадает в таблицу, даже если открытых портов у него нет
+    void add_host(const RttEstimator::HostRtt& h, int timeout_ms);
+    // Дописывает таблицу хостов и пул, затем заголовок; false — ошибка записи
+    bool finish();
+
+private:
+    FILE* file = nullptr;
+    uint64_t records = 0;
+    std::vector<ResultFormat::HostRecord> hosts;
+    std::unordered_map<uint32_t, uint32_t> host_index;
+    std::string pool;
+    std::unordered_map<std::string, uint32_t> pool_index;
+    std::string target;
+
+    uint32_t host_of(uint32_t ip);
+    uint32_t intern(const std::string& s);
+};
+
+// Читатель: файл отображается в память целиком, записи и строки отдаются без копий
+class ResultFile {
+public:
+    ResultFile() = default;
+    ~ResultFile();
+    ResultFile(const ResultFile&) = delete;
+    ResultFile& operator=(const ResultFile&) = delete;
+
+    // false — файла нет, он обрезан, не того формата или недописан; причина в err
+    bool open(const std::string& path, std::string& err);
+
+    std::string_view target() const { return string_at(head->target_offset, head->target_len); }
+    uint64_t record_count() const { return head->record_count; }
+    const ResultFormat::PortRecord& record(uint64_t i) const { return records[i]; }
+    uint64_t host_count() const { return head->host_count; }
+    const ResultFormat::HostRecord& host(uint64_t i) const { return hosts[i]; }
+
+    uint32_t ip(const ResultFormat::PortRecord& r) const { return hosts[r.host].ip; }
+    Proto proto(const ResultFormat::PortRecord& r) const {
+        return r.proto == (uint8_t)Proto::UDP ? Proto::UDP : Proto::TCP;
+    }
+    std::string_view banner(const ResultFormat::PortRecord& r) const {
+        return string_at(r.banner_offset, r.banner_len);
+    }
+    // Поля опознания сервиса; пустые, если сигнатуры не подошли
+    std::string_view service(const ResultFormat::PortRecord& r) const { return service_field(r, 0); }
+    std::string_view product(const ResultFormat::PortRecord& r) const { return service_field(r, 1); }
+    std::string_view version(const ResultFormat::PortRecord& r) const { return service_field(r, 2); }
+
+private:
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    const ResultFormat::Header* head = nullptr;
+    const ResultFormat::PortRecord* records = nullptr;
+    const ResultFormat::HostRecord* hosts = nullptr;
+    const char* pool = nullptr;
+
+    std::string_view string_at(uint32_t offset, uint32_t len) const {
+        return {pool + offset, len};
+    }
+    std::string_view service_field(const ResultFormat::PortRecord& r, int k) const;
+};
@@ -0,0 +1,79 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Файл состояния для --resume, little-endian:
+//
+//   Header | нули до kBitmapOffset | битовая карта проб шарда
+//
+// Бит j — проба шарда с номером j (TCP, затем UDP) отработала, а её находка
+// уже в журнале результатов (NDJSON). Карта отображается через mmap; отметки
+// сначала ложатся в копию в памяти, а в файл переносятся раз в kCheckpointMs:
+// снимок изменённых страниц -> fsync журнала -> OR снимка в карту и msync. Так
+// в файл не попадает проба, чья находка ещё не на диске, а на горячем пути
+// остаётся один атомарный OR. Конфигурация (цели, порты, шард) сверяется по
+// хэшу; seed хранится в файле и при продолжении берётся оттуда.
+namespace ResumeFormat {
+    constexpr char kMagic[4] = {'S', 'C', 'N', 'S'};
+    constexpr uint16_t kVersion = 1;
+    constexpr uint64_t kBitmapOffset = 4096;
+
+    struct Header {
+        char magic[4];
+        uint16_t version;
+        uint16_t reserved;
+        uint64_t config;       // хэш целей, портов и шарда
+        uint64_t seed;
+        uint64_t shard_index;
+        uint64_t shard_count;
+        uint64_t tcp_probes;   // проб шарда; карта — tcp_probes + udp_probes бит
+        uint64_t udp_probes;
+        uint64_t pad;
+    };
+
+    static_assert(sizeof(Header) == 64, "Header layout");
+}
+
+class ResumeState {
+public:
+    static constexpr int kCheckpointMs = 1000;
+
+    ResumeState() = default;
+    ~ResumeState();
+    ResumeState(const ResumeState&) = delete;
+    ResumeState& operator=(const ResumeState&) = delete;
+
+    // Открывает существующий файл (header.seed заполняется из него, если там
+    // 0) или создаёт новый; false + err — файл от другой конфигурации или ошибка
+    bool open(const std::string& path, ResumeFormat::Header& header, std::string& err);
+
+    bool done(uint64_t bit) const {
+        return bits[bit / 64].load(std::memory_order_relaxed) >> (bit % 64) & 1;
+    }
+    // Можно звать из любого потока
+    void mark(uint64_t bit);
+    // Переносит отметки в файл; durable() должен сделать записанными на диск
+    // все находки, выданные до его вызова. false — ошибка msync
+    bool checkpoint(const std::function<void()>& durable);
+
+    // Сколько проб было сделано к моменту open()
+    uint64_t resumed() const { return done_at_open; }
+
+private:
+    // Слово карты в файле и в памяти — 64 пробы, страница — 512 слов
+    static constexpr uint64_t kPageWords = 512;
+
+    int fd = -1;
+    uint64_t* map = nullptr;     // карта в файле
+    size_t map_bytes = 0;
+    uint64_t words = 0;
+    std::unique_ptr<std::atomic<uint64_t>[]> bits;   // карта в памяти
+    std::unique_ptr<std::atomic<uint64_t>[]> dirty;  // страницы, изменённые с прошлого checkpoint
+    uint64_t done_at_open = 0;
+    std::vector<uint64_t> snapshot;
+    std::vector<uint64_t> snapshot_pages;
+};
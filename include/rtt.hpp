@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Оценка RTT по каждому хосту, как в TCP (RFC 6298): SRTT/RTTVAR обновляются
+// каждым ответом (SYN-ACK или RST), а таймаут пробы выводится из них и
+// зажимается в [min_ms, max_ms]. Пока ответов от хоста нет — initial_ms.
+// Общая на все потоки сканера: карта разбита на полосы со своими мьютексами.
+class RttEstimator {
+public:
+    struct HostRtt {
+        uint32_t ip;
+        uint32_t srtt_us;
+        uint32_t rttvar_us;
+        uint32_t samples;
+    };
+
+    RttEstimator(int initial_ms, int min_ms, int max_ms);
+
+    void sample(uint32_t ip, uint64_t rtt_us);
+    int timeout_ms(uint32_t ip) const;
+    // Таймаут повторной пробы: удваивается на каждую попытку (RFC 6298, п. 5.5)
+    int timeout_ms(uint32_t ip, int attempt) const;
+
+    // Все хосты с замерами, по возрастанию адреса
+    std::vector<HostRtt> snapshot() const;
+
+private:
+    static const int kStripes = 64;
+    struct Stripe {
+        mutable std::mutex mtx;
+        std::unordered_map<uint32_t, HostRtt> hosts;
+    };
+
+    int initial_ms;
+    int min_ms;
+    int max_ms;
+    Stripe stripes[kStripes];
+
+    Stripe& stripe(uint32_t ip) { return stripes[(ip * 2654435761u) >> 26]; }
+    const Stripe& stripe(uint32_t ip) const { return stripes[(ip * 2654435761u) >> 26]; }
+};
@@ -2,43 +2,206 @@
 #include <string>
 #include <vector>
 #include <thread>
-#include <mutex>
-#include <queue>
-#include <condition_variable>
 #include <atomic>
+#include <functional>
+#include <memory>
+#include "probe.hpp"
+#include "ports.hpp"
+#include "targets.hpp"
+#include "rtt.hpp"
+#include "banner_stage.hpp"
+#include "fingerprint.hpp"
+#include "rate_controller.hpp"
+#include "resume_state.hpp"
 
-// Результат по одному порту
+enum class Proto : uint8_t { TCP, UDP };
+
+// Результат по одной паре (адрес, порт)
 struct ScanResult {
+    uint32_t ip;   // host byte order
     int port;
     bool open;
-    std::string banner;
+    std::string banner;   // для UDP — начало ответа
+    ServiceInfo service;  // опознание по баннеру (--fingerprints)
+    Proto proto = Proto::TCP;
+};
+
+// Бэкенд connect-скана
+enum class ConnectBackend { EPOLL, URING };
+
+// Параметры запуска сканера
+struct ScanOptions {
+    int threads = 10;
+    bool syn_mode = false;
+    bool grab_banner = false;
+    int timeout_ms = 800;      // таймаут connect, пока RTT хоста неизвестен
+    int min_timeout_ms = 100;  // границы адаптивного таймаута
+    int max_timeout_ms = 3000;
+    int retries = 1;           // повторов пробы без ответа
+    int max_inflight = 512;    // сокетов в полёте на один поток connect-скана
+    int syn_inflight = 1 << 18; // проб в полёте у SYN-движка
+    int banner_inflight = 256; // соединений стадии баннеров
+    int banner_timeout_ms = 1500;
+    ConnectBackend backend = ConnectBackend::EPOLL;
+    int rate = 0;              // --rate: потолок проб в секунду на все движки (AIMD ниже него), 0 — без темпа
+    int udp_rate = 1000;       // UDP-проб (с повторами) в секунду, 0 — без ограничения
+    int udp_retries = 2;       // у UDP молчание — норма, повторов нужно больше
+    bool discover = false;     // --discover: сначала найти живые хосты, порты сканировать только у них
+    bool by_frequency = false; // --order frequency: сначала самые часто открытые порты
+    int cutoff = 0;            // --cutoff: остальные порты — только у хостов с открытым среди первых cutoff
+    uint64_t seed = 0;         // ключ перестановки проб; 0 — случайный
+    uint64_t shard_index = 0;  // этот запуск берёт пробы с номерами shard_index + k * shard_count
+    uint64_t shard_count = 1;
+};
+
+// Счётчики SYN- и UDP-скана для --stats
+struct ScanStats {
+    bool filter_counting = false;
+    uint64_t filtered = 0;        // отсеяно BPF-фильтром в ядре
+    uint64_t kernel_drops = 0;    // потеряно из-за переполненного кольца приёма
+    uint64_t udp_closed = 0;      // ICMP port unreachable
+    uint64_t udp_filtered = 0;    // ICMP host/admin unreachable
+    uint64_t udp_silent = 0;      // ни ответа, ни ICMP за все попытки (open|filtered)
+    bool paced = false;           // был --rate
+    RateController::Stats rate{};
+    bool discovered = false;      // прошёл поиск хостов (--discover)
+    uint64_t hosts_total = 0;
+    uint64_t hosts_alive = 0;
+    uint64_t alive_arp = 0;       // ... из них ответили на ARP
+    uint64_t alive_icmp = 0;
+    uint64_t alive_tcp = 0;
+    uint64_t discover_ms = 0;
+    uint64_t resumed = 0;         // проб, сделанных прошлыми запусками (--resume)
+    uint64_t baseline_probes = 0; // пар из --baseline в этом шарде, проверенных первыми
+    uint64_t cutoff_hosts = 0;    // хостов без открытых портов среди первых --cutoff
+    uint64_t cutoff_skipped = 0;  // ... и не отправленных им проб
 };
 
+// Итог сравнения с --baseline; baseline — пар прошлого скана в пределах этого
+struct DiffSummary {
+    uint64_t baseline = 0;
+    uint64_t confirmed = 0;  // открыты и сейчас
+    uint64_t opened = 0;
+    uint64_t closed = 0;
+    uint64_t changed = 0;    // открыты, но баннер или сервис другой
+};
+
+class NdjsonWriter;
+class Baseline;
+
 class Scanner {
 public:
-    Scanner(const std::string& target, const std::vector<int>& ports,
-            int threads, bool syn_mode, bool grab_banner);
+    // target — исходная строка -t/-iL для отчёта, адреса — в targets;
+    // udp_ports (-u) сканируются после TCP-портов ports
+    Scanner(const std::string& target, const TargetSet& targets, const PortSet& ports,
+            const PortSet& udp_ports, const ScanOptions& opts);
+
+    // Находки уходят в writer по мере обнаружения и в памяти не копятся
+    // (кроме пар (ip, port) SYN-скана для отсева повторов)
+    void stream_to(NdjsonWriter& writer) { stream = &writer; }
+    // Баннеры (-b) и UDP-ответы прогоняются через сигнатуры; fp должен жить до конца run()
+    void fingerprint_with(const Fingerprints& fp) { fingerprints = &fp; }
+
+    // Состояние --resume: сделанные пробы пропускаются, новые отмечаются.
+    // Находки должны уходить в NDJSON (stream_to) — карта ссылается на него.
+    // seed берётся из файла, если он уже есть. false + err — файл не подходит
+    bool resume_from(const std::string& path, std::string& err);
+    // Прекратить выдачу новых проб; начатые доработают. Можно звать из обработчика сигнала
+    void stop() { stopping.store(true); }
+    bool interrupted() const { return stopping.load(); }
+    // Дифференциальный скан: сначала пробы открытых в b пар, затем остальное
+    // без них; b должен жить до save_diff()
+    void diff_against(const Baseline& b) { baseline = &b; }
 
-    std::vector<ScanResult> run();
+    // Число найденных открытых портов
+    uint64_t run();
     void save_json(const std::string& path) const;
+    // false — файл не записан (причина уже в stderr)
+    bool save_binary(const std::string& path) const;
+    // Только отличия от --baseline; baseline_name — для отчёта. false — файл не записан
+    bool save_diff(const std::string& path, const std::string& baseline_name,
+                   DiffSummary& summary) const;
+    const ScanStats& stats() const { return scan_stats; }
+    // Проб в этом шарде (TCP и UDP)
+    uint64_t probe_count() const;
 
 private:
     std::string target;
-    std::vector<int> ports;
-    int thread_count;
-    bool syn_scan;
-    bool banner_grab;
+    TargetSet targets;
+    ScanOptions opts;
+    uint64_t seed;  // ключ перестановок (opts.seed или случайный)
+    ProbeSpace space;
+    ProbeSpace udp_space;
+    RttEstimator rtt;
+    // Общий темп проб (--rate) для всех движков поиска
+    std::unique_ptr<RateController> rate;
+    // Номер следующей пробы внутри шарда; воркеры забирают его пачками по
+    // kClaimChunk одним fetch_add, так что общая линия кэша почти не прыгает
+    std::atomic<uint64_t> cursor{0};
+    std::atomic<bool> stopping{false};
+    std::unique_ptr<ResumeState> resume;
+    // --baseline: пары прошлого скана в пределах этого (ключи Baseline::key,
+    // по возрастанию) и номера их проб в шарде — они идут раньше общего обхода
+    const Baseline* baseline = nullptr;
+    std::vector<uint64_t> expected;
+    std::vector<uint64_t> priority;
+    std::vector<uint64_t> udp_priority;
+    std::atomic<uint64_t> priority_cursor{0};
+    // --cutoff: отметки «у хоста есть открытый порт» по номеру в targets, хосты
+    // второго прохода и число проб первого
+    std::unique_ptr<std::atomic<uint8_t>[]> host_hit;
+    TargetSet tail_targets;
+    uint64_t head_probes = 0;
 
-    std::queue<int> task_queue;
-    mutable std::mutex queue_mtx;
-    std::condition_variable cv;
-    std::atomic<bool> done{false};
+    // Забранная воркером пачка проб [next, end); listed — номера в priority
+    struct Claim {
+        uint64_t next = 0;
+        uint64_t end = 0;
+        bool listed = false;
+    };
+    // Открытые порты одного потока; выравнивание разводит буферы соседних
+    // потоков по разным линиям кэша. Сливаются в results после join()
+    struct alignas(64) ResultBuffer {
+        std::vector<ScanResult> items;
+    };
 
     std::vector<ScanResult> results;
-    mutable std::mutex results_mtx;
+    // Находки SYN-скана: баннеров нет, так что хватает открытых портов по хостам.
+    // С -b это только фильтр повторов, а сами находки приходят из стадии баннеров
+    HostPorts syn_open;
+    std::vector<ResultBuffer> thread_results;
+    // Стадия баннеров (-b) и её результаты; буфер пишет только поток стадии
+    std::unique_ptr<BannerStage> banners;
+    ResultBuffer banner_results;
+    NdjsonWriter* stream = nullptr;
+    const Fingerprints* fingerprints = nullptr;
+    ScanStats scan_stats;
 
-    void worker();
-    bool scan_tcp_connect(int port, std::string& banner);
-    bool scan_tcp_syn(int port);
-    std::string grab_banner_from_socket(int sock);
+    // Все находки по возрастанию адреса и порта
+    void for_each_result(const std::function<void(const ScanResult&)>& fn) const;
+    void worker(size_t id);
+    void emit(std::vector<ScanResult>& out, ScanResult r);
+    // Открытый порт от поиска: в стадию баннеров, если она есть, иначе сразу в out
+    void found(std::vector<ScanResult>& out, const ProbeTask& task);
+    bool next_task(Claim& claim, ProbeTask& task);
+    void connect_worker(Claim& claim, std::vector<ScanResult>& out,
+                        std::vector<ProbeTask> carry = {});
+    void uring_worker(Claim& claim, std::vector<ScanResult>& out);
+    // Проход TCP-поиска по space: SYN-скан или, если он не поднялся, connect.
+    // true — был SYN-скан
+    bool tcp_pass();
+    bool syn_scan();
+    // Проход по первым opts.cutoff портам, затем по остальным у хостов с находками
+    bool cutoff_scan();
+    void hit(uint32_t ip);
+    void udp_scan();
+    // Поиск хостов: targets сужается до ответивших, пространства проб строятся заново
+    void discover();
+    // Пары baseline в пределах скана: до discover() — все, после — номера проб
+    void collect_expected();
+    void prioritize();
+    // Проба отработала (и её находка уже отдана) — отметка для --resume;
+    // base — смещение пространства в карте (UDP идёт после TCP)
+    void completed(const ProbeSpace& sp, uint64_t base, const ProbeTask& task);
+    bool skip_done(uint64_t bit) const { return resume && resume->done(bit); }
 };
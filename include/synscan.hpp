@@ -1,6 +1,82 @@
 #pragma once
+#include <atomic>
+#include <cstdint>
 #include <string>
+#include <sys/socket.h>
+#include "probe.hpp"
+#include "inflight_table.hpp"
+#include "rtt.hpp"
+#include "packet_ring.hpp"
+#include "bpf_filter.hpp"
+#include "rate_controller.hpp"
 
 #ifdef __linux__
-bool syn_probe_linux(const std::string& dst_ip, int port, int timeout_ms);
+// SYN-движок в стиле masscan/zmap: один поток шлёт SYN, другой принимает
+// SYN-ACK/RST. Номер последовательности (и порт источника) выводится из
+// ключевого хэша (dst ip, dst port, src port), и ответ проверяется по ack_seq,
+// так что чужие пакеты не принимаются за ответ. Состояние держится только для
+// проб в полёте (InflightTable): по колесу таймеров они повторяются до retries
+// раз, а время отправки даёт замер RTT для адаптивного таймаута.
+// Ответы читаются из mmap-кольца AF_PACKET, а если оно недоступно — из raw-сокета.
+class SynEngine {
+public:
+    // open = true для SYN-ACK, false для RST. Один и тот же (ip, port) может
+    // прийти несколько раз (повторы, дубли) — дедуплицирует вызывающий.
+    using ReplyFn = std::function<void(const ProbeTask&, bool open)>;
+
+    // rtt — таймауты проб и замеры по ответам; max_outstanding — сколько проб
+    // может ждать ответа одновременно; wait_ms — сколько ещё ждать запоздавших
+    // ответов, когда все пробы отработали свои таймауты
+    SynEngine(RttEstimator& rtt, int retries, size_t max_outstanding, int wait_ms);
+    ~SynEngine();
+
+    // Открывает сокеты (нужен root) и вешает на приём фильтр в ядре;
+    // [first_ip, last_ip] — диапазон целей, по first_ip выбирается маршрут
+    bool open(uint32_t first_ip, uint32_t last_ip);
+
+    // Отправка (и повторы) — в темпе rate; ему же идут ответы и потери в ядре
+    void pace_with(RateController* r) { rate = r; }
+
+    // on_expired зовёт поток отправки для проб, оставшихся без ответа
+    void run(const NextProbeFn& next, const ReplyFn& on_reply,
+             const ExpiredFn& on_expired = nullptr);
+
+    // SYN, которые ядро отказалось отправить (ENOBUFS/EAGAIN — только если буфер не освободился за kSendStallMs)
+    uint64_t send_failures() const { return send_errors; }
+    int last_error() const { return last_send_errno; }
+
+    // Ответы, отброшенные ядром из-за переполненного кольца (только для AF_PACKET)
+    bool ring_mode() const { return ring.is_open(); }
+    uint64_t kernel_drops() { return ring.stats().drops; }
+
+    // Пакеты, которые фильтр отсёк в ядре (0, если счётчик недоступен)
+    bool filter_counting() const { return filter.counting(); }
+    uint64_t filtered_packets() const { return filter.filtered(); }
+
+private:
+    RttEstimator& rtt;
+    int retries;
+    int wait_ms;
+    int send_fd = -1;
+    int recv_fd = -1;
+    PacketRing ring;
+    ReplyFilter filter;
+    uint32_t src_ip = 0;     // host byte order
+    uint64_t key[2]{};
+    std::atomic<bool> sending{false};
+    std::atomic<uint64_t> last_send_ms{0};
+    std::atomic<uint64_t> send_errors{0};
+    int last_send_errno = 0;
+    RateController* rate = nullptr;
+
+    // Пробы в полёте; пишет поток отправки, поток приёма только помечает ответы
+    InflightTable inflight;
+
+    uint32_t cookie(uint32_t ip, uint16_t port, uint16_t sport) const;
+    uint16_t source_port(uint32_t ip, uint16_t port) const;
+    void sender(const NextProbeFn& next, const ExpiredFn& on_expired);
+    void flush(mmsghdr* msgs, int n);
+    void receiver(const ReplyFn& on_reply);
+    void on_packet(const uint8_t* pkt, size_t n, const ReplyFn& on_reply);
+};
 #endif
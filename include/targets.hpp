@@ -0,0 +1,76 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "permutation.hpp"
+#include "probe.hpp"
+
+// Множество IPv4-адресов целей: отсортированные непересекающиеся диапазоны.
+// Адрес по номеру ищется бинпоиском, сами адреса в память не разворачиваются.
+class TargetSet {
+public:
+    // Одна спецификация или несколько через запятую: 10.0.0.1, 10.0.0.0/24,
+    // 10.0.0.1-10.0.0.50, 10.0.0.1-50, имя хоста. false + err при ошибке.
+    bool add(const std::string& spec, std::string& err);
+    // Файл со спецификациями: по одной на строке, # — комментарий
+    bool add_file(const std::string& path, std::string& err);
+
+    uint64_t size() const { return total; }
+    bool empty() const { return total == 0; }
+    uint32_t at(uint64_t index) const;
+    // Номер адреса в множестве; false — адреса в нём нет
+    bool index_of(uint32_t ip, uint64_t& index) const;
+    // Адреса с номерами, для которых keep(номер) == true
+    TargetSet subset(const std::function<bool(uint64_t)>& keep) const;
+    // Хэш самих адресов (а не спецификации) — сверить, что цели не поменялись
+    uint64_t digest() const;
+    uint32_t first_ip() const { return ranges.front().first; }
+    uint32_t last_ip() const { return ranges.back().last; }
+
+private:
+    struct Range {
+        uint32_t first;
+        uint32_t last;
+        uint64_t offset;   // номер первого адреса диапазона во всём множестве
+    };
+    std::vector<Range> ranges;
+    uint64_t total = 0;
+
+    bool parse(const std::string& spec, std::string& err);
+    bool add_one(const std::string& spec, std::string& err);
+    void normalize();
+};
+
+// Всё пространство проб (адрес, порт) в случайном порядке: номер пробы
+// пропускается через Permutation, так что подряд идущие пробы почти всегда
+// уходят на разные хосты. Память — O(диапазонов + портов).
+// Порты можно разбить на ярусы (tiers — концы ярусов в ports по возрастанию):
+// тогда сначала идут все пробы первого яруса, потом второго, и случайный
+// порядок — внутри яруса. Без ярусов всё пространство — один ярус.
+class ProbeSpace {
+public:
+    ProbeSpace(const TargetSet& targets, const std::vector<uint16_t>& ports, uint64_t seed,
+               const std::vector<size_t>& tiers = {});
+
+    uint64_t size() const { return total; }
+    ProbeTask at(uint64_t index) const;
+    // Номер пробы task; false — такой пары в пространстве нет
+    bool index_of(const ProbeTask& task, uint64_t& index) const;
+    const std::vector<uint16_t>& port_list() const { return ports; }
+    const std::vector<size_t>& tier_ends() const { return tiers; }
+
+private:
+    struct Tier {
+        size_t first_slot;  // первый порт яруса в ports
+        uint64_t offset;    // номер первой пробы яруса
+        Permutation perm;
+    };
+
+    const TargetSet* targets;
+    std::vector<uint16_t> ports;
+    std::vector<uint16_t> port_slot;  // порт -> номер в ports
+    std::vector<size_t> tiers;
+    std::vector<Tier> parts;
+    uint64_t total = 0;
+};
@@ -0,0 +1,46 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Иерархическое колесо таймеров (Varghese & Lauck): 4 уровня по 256 ячеек,
+// шаг нижнего уровня — 1 мс, верхний покрывает ~49 дней. Вставка и срабатывание
+// O(1); таймер с дальнего уровня спускается вниз, когда до него доходит очередь.
+// Отмены нет: владелец кладёт в payload поколение и сам отбрасывает устаревшее.
+class TimingWheel {
+public:
+    using FireFn = std::function<void(uint64_t payload)>;
+
+    explicit TimingWheel(uint64_t now_ms);
+
+    // Таймер в прошлом сработает при ближайшем advance()
+    void add(uint64_t at_ms, uint64_t payload);
+
+    // Срабатывают все таймеры с at_ms <= now_ms; fn может добавлять новые
+    void advance(uint64_t now_ms, const FireFn& fn);
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    // Сколько ждать до ближайшего таймера (может вернуть раньше — на
+    // границе уровня), -1 — таймеров нет
+    int next_timeout_ms(uint64_t now_ms) const;
+
+private:
+    static const int kLevels = 4;
+    static const int kBits = 8;
+    static const int kSlots = 1 << kBits;
+
+    struct Entry {
+        uint64_t at_ms;
+        uint64_t payload;
+    };
+
+    std::vector<Entry> buckets[kLevels][kSlots];
+    uint64_t current;   // следующая необработанная миллисекунда
+    size_t count = 0;
+
+    void place(const Entry& e);
+    void cascade(int level);
+};
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// TLS-проба без TLS-библиотеки: заранее собранный ClientHello (TLS 1.2, без
+// SNI — сканируем адреса) и разбор ответа сервера по мере прихода байтов.
+// Рукопожатие не завершается: из ServerHello берутся версия и шифр, из
+// Certificate — поля листового сертификата. В TLS 1.3 сертификат уже
+// зашифрован, так что от него остаются только версия и шифр.
+
+// Запись TLS с ClientHello; живёт до конца программы
+std::string_view tls_client_hello();
+
+// Поля листового сертификата (X.509)
+struct CertInfo {
+    std::string subject;      // "CN=example.com,O=Example"
+    std::string issuer;
+    std::string not_before;   // "2026-10-17T07:00:00Z"
+    std::string not_after;
+    std::vector<std::string> san;  // dNSName и iPAddress
+};
+
+// Разбор DER-сертификата; false — не похоже на X.509
+bool parse_certificate(const uint8_t* der, size_t n, CertInfo& out);
+
+// Ответ сервера на ClientHello, склеиваемый из кусков recv()
+class TlsReader {
+public:
+    enum class Status {
+        MORE,     // нужно ещё данных
+        DONE,     // всё, что видно без рукопожатия, получено
+        NOT_TLS,  // сервер ответил не TLS; что прислал — в raw()
+    };
+
+    Status feed(const char* data, size_t n);
+    // Хоть одна запись TLS разобрана
+    bool started() const { return version != 0 || alert >= 0; }
+    std::string_view raw() const { return pending; }
+
+    // Баннер: "TLSv1.2 cipher=0xc02f subject="..." issuer="..." san=a,b
+    // not_before=... not_after=...", не длиннее kMaxTlsBannerLen
+    std::string summary() const;
+
+private:
+    static constexpr size_t kMaxBuffered = 64 * 1024;
+    static constexpr size_t kMaxTlsBannerLen = 1024;
+
+    std::string pending;    // неразобранный хвост записей
+    std::string handshake;  // склеенные сообщения handshake
+    uint16_t version = 0;   // из ServerHello (для 1.3 — из supported_versions)
+    uint16_t cipher = 0;
+    int alert = -1;
+    bool have_cert = false;
+    CertInfo cert;
+
+    Status handshake_messages();
+    bool server_hello(const uint8_t* p, size_t n);
+};
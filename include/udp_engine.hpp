@@ -0,0 +1,80 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <sys/socket.h>
+#include "probe.hpp"
+#include "inflight_table.hpp"
+#include "rate_controller.hpp"
+#include "rtt.hpp"
+
+// Полезная нагрузка UDP-пробы для порта: запрос, на который сервис ответит
+// (DNS, NTP, SNMP, IKE, ...), или пустая датаграмма для остальных портов
+std::string_view udp_payload(uint16_t port);
+
+#ifdef __linux__
+// UDP-скан: пробы с нагрузкой по порту уходят пачками через sendmmsg с одного
+// неподключённого сокета, ответы собираются recvmmsg и сверяются с таблицей
+// проб в полёте по адресу источника. ICMP port unreachable (закрытый порт)
+// ловит raw-сокет ICMP — по вложенному заголовку UDP видно, на какую пробу
+// пришла ошибка; без root вместо него очередь ошибок сокета (IP_RECVERR).
+//
+// Молчание у UDP ничего не значит, а хосты ограничивают частоту ICMP, поэтому
+// пробы без ответа повторяются с удвоением таймаута (rtt.timeout_ms), а
+// отправка — и новые пробы, и повторы — идёт не быстрее pps пакетов в секунду.
+// Всё в одном потоке: отправка, таймеры и приём чередуются через poll().
+class UdpEngine {
+public:
+    enum class Reply {
+        OPEN,      // пришёл UDP-ответ; data/n — его начало
+        CLOSED,    // ICMP port unreachable
+        FILTERED,  // ICMP host/admin unreachable — повторять бессмысленно
+    };
+    // Вызывается один раз на пробу; пробы без ответа только считаются в silent()
+    using ReplyFn = std::function<void(const ProbeTask&, Reply, const char* data, size_t n)>;
+
+    // pps — верхняя граница пакетов в секунду (0 — без ограничения)
+    UdpEngine(RttEstimator& rtt, int retries, size_t max_outstanding, int pps);
+    ~UdpEngine();
+
+    bool open();
+    // Помимо своего pps — общий темп rate (--rate); ему же идут ответы и потери
+    void pace_with(RateController* r) { rate = r; }
+    // on_expired — для проб, оставшихся без ответа (они же считаются в silent())
+    void run(const NextProbeFn& next, const ReplyFn& on_reply,
+             const ExpiredFn& on_expired = nullptr);
+
+    // Закрытые порты видны через raw-сокет ICMP (иначе через IP_RECVERR)
+    bool icmp_raw() const { return icmp_fd >= 0; }
+    // Пробы, так и не получившие ответа (open|filtered)
+    uint64_t silent() const { return silent_probes; }
+    uint64_t send_failures() const { return send_errors; }
+    int last_error() const { return last_send_errno; }
+
+private:
+    // Токенов, которые движок берёт у RateController за раз
+    static constexpr size_t kRateChunk = 16;
+
+    RttEstimator& rtt;
+    int retries;
+    int pps;
+    int fd = -1;
+    int icmp_fd = -1;
+    uint16_t local_port = 0;  // host byte order
+    uint64_t silent_probes = 0;
+    uint64_t send_errors = 0;
+    int last_send_errno = 0;
+    RateController* rate = nullptr;
+    size_t credit = 0;  // взятые, но ещё не потраченные токены rate
+
+    InflightTable inflight;
+
+    void flush(mmsghdr* msgs, int n);
+    // Ответ на пробу (ip, port): снимает её с повторов; false — пробы нет или уже отвечена
+    bool answer(uint32_t ip, uint16_t port);
+    void drain_replies(const ReplyFn& on_reply);
+    void drain_icmp(const ReplyFn& on_reply);
+    void drain_errqueue(const ReplyFn& on_reply);
+    void on_unreachable(uint32_t ip, uint16_t port, uint8_t code, const ReplyFn& on_reply);
+};
+#endif
@@ -0,0 +1,68 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "probe.hpp"
+#include "rate_controller.hpp"
+#include "rtt.hpp"
+
+// io_uring-бэкенд connect-скана (Linux 5.6+): CONNECT со связанным таймаутом
+// и CLOSE уходят в кольцо пачками, без отдельного syscall на операцию.
+// Только поиск портов: баннеры снимает BannerStage.
+// Таймеры здесь — связанные таймауты самого кольца; CONNECT, отменённый по
+// таймауту, повторяется до retries раз.
+class UringEngine {
+public:
+    using DoneFn = std::function<void(const ProbeTask&, bool open)>;
+
+    // rtt — как у ConnectEngine: таймаут CONNECT по хосту и замеры RTT
+    UringEngine(int max_inflight, RttEstimator& rtt, int retries);
+    ~UringEngine();
+
+    // Ядро умеет все нужные операции (проверяется через IORING_REGISTER_PROBE)
+    static bool supported();
+
+    // false — кольцо не создалось (ENOMEM, RLIMIT_MEMLOCK на ядрах до 5.12) или
+    // сломалось посреди скана; пробы, по которым done() не вызывался, возвращает unfinished()
+    bool run(const NextProbeFn& next, const DoneFn& done);
+    const std::vector<ProbeTask>& unfinished() const { return leftovers; }
+    int last_error() const { return error; }
+
+    // CONNECT (и повторы) — в темпе rate; ему же идут ответы
+    void pace_with(RateController* r) { rate = r; }
+
+private:
+    // Токенов, которые движок берёт у RateController за раз
+    static constexpr size_t kRateChunk = 16;
+
+    enum class Stage : uint8_t { IDLE, CONNECT, CLOSE };
+
+    struct Slot;
+    struct Ring;
+    struct Retry {
+        ProbeTask task;
+        uint8_t attempt;
+    };
+
+    int max_inflight;
+    RttEstimator& rtt;
+    int retries;
+    RateController* rate = nullptr;
+    size_t credit = 0;  // взятые, но ещё не потраченные токены
+
+    Ring* ring = nullptr;
+    std::vector<Slot> slots;
+    std::vector<uint32_t> free_slots;
+    unsigned queued = 0; // SQE, ещё не отданные ядру
+    bool broken = false;
+    int error = 0;
+    std::vector<ProbeTask> leftovers;
+    std::vector<Retry> retry_queue;
+
+    bool submit();
+    void reserve(unsigned n);
+    void abort_outstanding();
+    bool start(const ProbeTask& task, uint8_t attempt, const DoneFn& done);
+    void on_complete(uint64_t user_data, int res, const DoneFn& done);
+    void submit_close(uint32_t idx);
+};
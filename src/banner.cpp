@@ -1,54 +1,71 @@
 #include "banner.hpp"
-#include <arpa/inet.h>
-#include <unistd.h>
-#include <fcntl.h>
-#include <sys/select.h>
-#include <cstring>
+#include "ports.hpp"
+#include "tls_probe.hpp"
+#include <algorithm>
+#include <iostream>
+#include <vector>
 
-bool tcp_connect_with_timeout(const std::string& ip, int port, int timeout_ms, int& out_sock) {
-    out_sock = socket(AF_INET, SOCK_STREAM, 0);
-    if (out_sock < 0) return false;
+using namespace std::literals;
 
-    int flags = fcntl(out_sock, F_GETFL, 0);
-    fcntl(out_sock, F_SETFL, flags | O_NONBLOCK);
+// --- Таблица проб ---
+// Порядок строк — приоритет для порта, попавшего в несколько подсказок
+static const BannerProbe kProbes[] = {
+    {"null", ""sv, "21-23,25,110,143,587,2222,3306,5900-5910,6667", kGreetFull},
+    // Порты, где TLS начинается сразу после connect
+    {"tls", tls_client_hello(),
+     "443,465,636,853,989-990,992-995,2083,2087,3269,4443,5061,5986,6443,8443,9443", 0,
+     ProbeKind::TLS},
+    {"http", "HEAD / HTTP/1.0\r\n\r\n"sv,
+     "80-81,591,2080,3000,5000,7001,8000-8010,8080-8090,8888,9000,9090", 0},
+    {"redis", "*1\r\n$4\r\nPING\r\n"sv, "6379", 0},
+    {"memcached", "version\r\n"sv, "11211", 0},
+    {"rtsp", "OPTIONS / RTSP/1.0\r\n\r\n"sv, "554,8554", 0},
+    // version.bind CH TXT, DNS поверх TCP (длина сообщения в первых двух байтах)
+    {"dns-version", "\x00\x1e" "\x00\x06\x01\x00\x00\x01\x00\x00\x00\x00\x00\x00"
+                    "\x07" "version" "\x04" "bind" "\x00" "\x00\x10\x00\x03"sv, "53", 0},
+    // SSLRequest: на него PostgreSQL отвечает одним байтом S/N
+    {"postgres", "\x00\x00\x00\x08\x04\xd2\x16\x2f"sv, "5432", 0},
+    // Порт без подсказки: короткое окно под приветствие, затем HTTP
+    {"generic", "HEAD / HTTP/1.0\r\n\r\n"sv, nullptr, 300},
+};
+static const size_t kProbeCount = sizeof(kProbes) / sizeof(kProbes[0]);
 
-    sockaddr_in addr{}; addr.sin_family = AF_INET;
-    addr.sin_port = htons(port);
-    inet_pton(AF_INET, ip.c_str(), &addr.sin_addr);
-
-    int r = connect(out_sock, (struct sockaddr*)&addr, sizeof(addr));
-    if (r == 0) return true;
-    if (errno != EINPROGRESS) { close(out_sock); return false; }
-
-    fd_set wfds; FD_ZERO(&wfds); FD_SET(out_sock, &wfds);
-    timeval tv{ timeout_ms/1000, (timeout_ms%1000)*1000 };
-
-    r = select(out_sock+1, nullptr, &wfds, nullptr, &tv);
-    if (r <= 0) { close(out_sock); return false; }
-
-    int err=0; socklen_t len=sizeof(err);
-    getsockopt(out_sock, SOL_SOCKET, SO_ERROR, &err, &len);
-    if (err != 0) { close(out_sock); return false; }
-
-    return true;
+// Подсказки разбираются один раз, при первом обращении
+static const std::vector<PortSet>& hint_sets() {
+    static const std::vector<PortSet> sets = [] {
+        std::vector<PortSet> out(kProbeCount);
+        for (size_t i = 0; i < kProbeCount; i++) {
+            std::string err;
+            if (kProbes[i].ports && !PortSet::parse(kProbes[i].ports, out[i], err)) {
+                std::cerr << "[!] Probe " << kProbes[i].name << ": " << err << "\n";
+            }
+        }
+        return out;
+    }();
+    return sets;
 }
 
-std::string try_grab_banner(int sock, int port, int timeout_ms) {
-    timeval tv{ timeout_ms/1000, (timeout_ms%1000)*1000 };
-    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
-    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
-
-    char buf[1024]{};
-    std::string banner;
-
-    int n = recv(sock, buf, sizeof(buf)-1, MSG_DONTWAIT);
-    if (n > 0) { buf[n] = '\0'; banner += buf; }
-
-    const char* probe = "HEAD / HTTP/1.0\r\n\r\n";
-    send(sock, probe, strlen(probe), 0);
-    n = recv(sock, buf, sizeof(buf)-1, 0);
-    if (n > 0) { buf[n] = '\0'; banner += buf; }
+const BannerProbe* banner_probe(uint16_t port, unsigned step) {
+    if (step >= kMaxProbesPerPort) return nullptr;
+    const auto& hints = hint_sets();
+    const BannerProbe* plan[kMaxProbesPerPort];
+    unsigned n = 0;
+    // Сначала пробы с подсказкой, потом общие — кроме уже стоящих в плане
+    for (int pass = 0; pass < 2 && n <= step; pass++) {
+        for (size_t i = 0; i < kProbeCount && n <= step; i++) {
+            const BannerProbe& p = kProbes[i];
+            bool hinted = p.ports && hints[i].contains(port);
+            if (pass == 0 ? !hinted : p.ports != nullptr) continue;
+            bool dup = std::any_of(plan, plan + n, [&](const BannerProbe* q) {
+                return q->payload == p.payload;
+            });
+            if (!dup) plan[n++] = &p;
+        }
+    }
+    return step < n ? plan[step] : nullptr;
+}
 
-    if (banner.size() > 200) banner.resize(200);
-    return banner;
+void append_banner(std::string& banner, const char* data, long n) {
+    if (n <= 0 || banner.size() >= kMaxBannerLen) return;
+    banner.append(data, std::min((size_t)n, kMaxBannerLen - banner.size()));
 }
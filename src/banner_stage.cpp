@@ -0,0 +1,57 @@
+#include "banner_stage.hpp"
+#include "connect_engine.hpp"
+#include <chrono>
+
+BannerStage::BannerStage(int max_inflight, int timeout_ms, RttEstimator& rtt, int retries,
+                         size_t queue_limit)
+    : max_inflight(max_inflight), timeout_ms(timeout_ms), rtt(rtt), retries(retries),
+      queue_limit(queue_limit) {}
+
+BannerStage::~BannerStage() {
+    finish();
+}
+
+void BannerStage::start(DoneFn done) {
+    thread = std::thread([this, done = std::move(done)] {
+        ConnectEngine engine(max_inflight, rtt, retries, true, timeout_ms);
+        engine.run([this](ProbeTask& task) { return next(task); },
+                   [&done](const ProbeTask& task, bool, const std::string& banner) {
+                       done(task, banner);
+                   },
+                   [this](int wait_ms) { return wait_more(wait_ms); });
+    });
+}
+
+void BannerStage::push(const ProbeTask& task) {
+    std::unique_lock<std::mutex> lock(mtx);
+    not_full.wait(lock, [this] { return queue.size() < queue_limit; });
+    queue.push_back(task);
+    if (queue.size() == 1) not_empty.notify_one();
+}
+
+void BannerStage::finish() {
+    if (!thread.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        closed = true;
+    }
+    not_empty.notify_one();
+    thread.join();
+}
+
+// --- Вход движка (поток стадии) ---
+bool BannerStage::next(ProbeTask& task) {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (queue.empty()) return false;
+    task = queue.front();
+    queue.pop_front();
+    if (queue.size() + 1 == queue_limit) not_full.notify_all();
+    return true;
+}
+
+bool BannerStage::wait_more(int wait_ms) {
+    std::unique_lock<std::mutex> lock(mtx);
+    not_empty.wait_for(lock, std::chrono::milliseconds(wait_ms),
+                       [this] { return !queue.empty() || closed; });
+    return !queue.empty() || !closed;
+}
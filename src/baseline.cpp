@@ -0,0 +1,232 @@
+#include "baseline.hpp"
+#include "result_file.hpp"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool Baseline::load(const std::string& path, std::string& err) {
+    FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) {
+        err = path + ": " + std::strerror(errno);
+        return false;
+    }
+    char magic[4] = {};
+    size_t n = std::fread(magic, 1, sizeof(magic), f);
+    std::fclose(f);
+    if (n == sizeof(magic) && std::memcmp(magic, ResultFormat::kMagic, sizeof(magic)) == 0) {
+        return load_binary(path, err);
+    }
+    return load_json(path, err);
+}
+
+const Baseline::Entry* Baseline::entry(uint32_t ip, uint16_t port, Proto proto) const {
+    auto it = entries.find(key(ip, port, proto));
+    return it == entries.end() ? nullptr : &it->second;
+}
+
+// Баннер и сервис храним только там, где они есть: без -b это одна карта портов
+void Baseline::add(uint32_t ip, uint16_t port, Proto proto, Entry e) {
+    if (!(proto == Proto::UDP ? udp : tcp).insert(ip, port)) return;
+    if (e.banner.empty() && e.service.service.empty()) return;
+    entries.emplace(key(ip, port, proto), std::move(e));
+}
+
+// --- .scnr: записи уже разобраны, остаётся пройти по ним ---
+bool Baseline::load_binary(const std::string& path, std::string& err) {
+    ResultFile in;
+    if (!in.open(path, err)) return false;
+    for (uint64_t i = 0; i < in.record_count(); i++) {
+        const auto& r = in.record(i);
+        if (!r.open) continue;
+        Entry e;
+        e.banner = in.banner(r);
+        e.service = {std::string(in.service(r)), std::string(in.product(r)),
+                     std::string(in.version(r))};
+        add(in.ip(r), r.port, in.proto(r), std::move(e));
+    }
+    return true;
+}
+
+// --- JSON/NDJSON этого сканера: поля записи всегда в одном порядке ---
+static bool hex4(const char* p, unsigned& v) {
+    v = 0;
+    for (int i = 0; i < 4; i++) {
+        char h = p[i];
+        v <<= 4;
+        if (h >= '0' && h <= '9') v |= h - '0';
+        else if (h >= 'a' && h <= 'f') v |= h - 'a' + 10;
+        else if (h >= 'A' && h <= 'F') v |= h - 'A' + 10;
+        else return false;
+    }
+    return true;
+}
+
+// Строка JSON после открывающей кавычки; p — за закрывающей
+static bool parse_string(const char*& p, const char* end, std::string& out) {
+    out.clear();
+    while (p < end) {
+        const char* q = (const char*)std::memchr(p, '"', end - p);
+        const char* bs = (const char*)std::memchr(p, '\\', (q ? q : end) - p);
+        if (!bs) {
+            if (!q) return false;
+            out.append(p, q - p);
+            p = q + 1;
+            return true;
+        }
+        out.append(p, bs - p);
+        p = bs + 1;
+        if (p >= end) return false;
+        char c = *p++;
+        switch (c) {
+        case 'n': out += '\n'; break;
+        case 'r': out += '\r'; break;
+        case 't': out += '\t'; break;
+        case 'b': out += '\b'; break;
+        case 'f': out += '\f'; break;
+        case 'u': {
+            unsigned v = 0;
+            if (end - p < 4 || !hex4(p, v)) return false;
+            p += 4;
+            // Наш писатель экранирует так только управляющие байты, но файл могли
+            // пересохранить с \uXXXX для всего не-ASCII, вплоть до суррогатных пар
+            if (v >= 0xd800 && v < 0xdc00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u') {
+                unsigned lo = 0;
+                if (hex4(p + 2, lo) && lo >= 0xdc00 && lo < 0xe000) {
+                    p += 6;
+                    v = 0x10000 + ((v - 0xd800) << 10) + (lo - 0xdc00);
+                }
+            }
+            if (v < 0x80) {
+                out += (char)v;
+            } else if (v < 0x800) {
+                out += (char)(0xc0 | (v >> 6));
+                out += (char)(0x80 | (v & 0x3f));
+            } else if (v < 0x10000) {
+                out += (char)(0xe0 | (v >> 12));
+                out += (char)(0x80 | ((v >> 6) & 0x3f));
+                out += (char)(0x80 | (v & 0x3f));
+            } else {
+                out += (char)(0xf0 | (v >> 18));
+                out += (char)(0x80 | ((v >> 12) & 0x3f));
+                out += (char)(0x80 | ((v >> 6) & 0x3f));
+                out += (char)(0x80 | (v & 0x3f));
+            }
+            break;
+        }
+        default: out += c; break;  // \" \\ \/
+        }
+    }
+    return false;
+}
+
+static void skip_ws(const char*& p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) ++p;
+}
+
+static bool skip(const char*& p, const char* end, std::string_view lit) {
+    if ((size_t)(end - p) < lit.size() || std::memcmp(p, lit.data(), lit.size()) != 0) return false;
+    p += lit.size();
+    return true;
+}
+
+// ,"name": — с пробелами где угодно (файл могли переформатировать); p — за ':'.
+// Если следующее поле другое, p не двигается
+static bool field(const char*& p, const char* end, std::string_view name) {
+    const char* q = p;
+    skip_ws(q, end);
+    if (!skip(q, end, ",")) return false;
+    skip_ws(q, end);
+    if (!skip(q, end, "\"") || !skip(q, end, name) || !skip(q, end, "\"")) return false;
+    skip_ws(q, end);
+    if (!skip(q, end, ":")) return false;
+    skip_ws(q, end);
+    p = q;
+    return true;
+}
+
+// ,"name":"..." — строковое поле
+static bool string_field(const char*& p, const char* end, std::string_view name, std::string& out) {
+    const char* q = p;
+    if (!field(q, end, name) || !skip(q, end, "\"") || !parse_string(q, end, out)) return false;
+    p = q;
+    return true;
+}
+
+bool Baseline::load_json(const std::string& path, std::string& err) {
+    // Файл читается через mmap один раз подряд, без копии в память процесса
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st{};
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        err = path + ": " + std::strerror(errno);
+        if (fd >= 0) ::close(fd);
+        return false;
+    }
+    size_t size = (size_t)st.st_size;
+    void* map = size ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0) : nullptr;
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        err = path + ": mmap: " + std::strerror(errno);
+        return false;
+    }
+    if (map) madvise(map, size, MADV_SEQUENTIAL);
+    std::string_view data(map ? (const char*)map : "", size);
+
+    // Записи результатов: {"ip":"a.b.c.d","port":N[,"proto":"udp"],"open":B,"banner":"..."
+    // [,"service":"..."[,"product":"..."][,"version":"..."]]; у записей хостов за
+    // адресом идёт не "port" — они пропускаются
+    // Объект ищется по '{' — он бывает раз на запись, а кавычки — десятки раз
+    const char* end = data.data() + data.size();
+    const char* next = data.data();
+    size_t records = 0;
+    std::string text;
+    while ((next = (const char*)std::memchr(next, '{', end - next)) != nullptr) {
+        const char* p = ++next;
+        skip_ws(p, end);
+        if (!skip(p, end, "\"ip\"")) continue;
+        skip_ws(p, end);
+        if (!skip(p, end, ":")) continue;
+        skip_ws(p, end);
+        if (!skip(p, end, "\"")) continue;
+        const char* q = (const char*)std::memchr(p, '"', end - p);
+        if (!q || q - p > 15) continue;
+        char dotted[16] = {};
+        std::memcpy(dotted, p, q - p);
+        in_addr addr{};
+        if (inet_pton(AF_INET, dotted, &addr) != 1) continue;
+        p = q + 1;
+
+        if (!field(p, end, "port")) continue;
+        uint32_t port = 0;
+        while (p < end && *p >= '0' && *p <= '9') port = port * 10 + (*p++ - '0');
+        if (port == 0 || port > 65535) continue;
+        Proto proto = Proto::TCP;
+        if (string_field(p, end, "proto", text) && text == "udp") proto = Proto::UDP;
+
+        bool open = false;
+        if (!field(p, end, "open")) continue;
+        if (skip(p, end, "true")) {
+            open = true;
+        } else if (!skip(p, end, "false")) {
+            continue;
+        }
+        Entry e;
+        string_field(p, end, "banner", e.banner);
+        if (string_field(p, end, "service", e.service.service)) {
+            string_field(p, end, "product", e.service.product);
+            string_field(p, end, "version", e.service.version);
+        }
+        next = p;
+        ++records;
+        if (open) add(ntohl(addr.s_addr), (uint16_t)port, proto, std::move(e));
+    }
+
+    bool ok = records > 0 || data.find("\"results\"") != std::string_view::npos;
+    if (map) munmap(map, size);
+    if (!ok) err = path + ": not a scan result (JSON, NDJSON or .scnr)";
+    return ok;
+}
@@ -0,0 +1,187 @@
+#include "bpf_filter.hpp"
+
+#ifdef __linux__
+#include <linux/bpf.h>
+#include <linux/filter.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstring>
+#include <vector>
+
+#ifndef SO_ATTACH_BPF
+#define SO_ATTACH_BPF 50
+#endif
+
+// Смещения в IPv4/TCP, которые проверяет фильтр
+static const int kIpFragOff = 6;
+static const int kIpProto = 9;
+static const int kIpSaddr = 12;
+static const int kIpDaddr = 16;
+static const int kTcpDport = 2;
+static const int kTcpFlags = 13;
+static const uint8_t kFlagRst = 0x04;
+static const uint8_t kFlagSynAck = 0x12;
+
+static long sys_bpf(int cmd, bpf_attr* attr) {
+    return syscall(__NR_bpf, cmd, attr, sizeof(*attr));
+}
+
+ReplyFilter::~ReplyFilter() {
+    if (prog_fd >= 0) close(prog_fd);
+    if (map_fd >= 0) close(map_fd);
+}
+
+bool ReplyFilter::attach(int fd, const Spec& spec) {
+    return attach_ebpf(fd, spec) || attach_classic(fd, spec);
+}
+
+uint64_t ReplyFilter::filtered() const {
+    if (map_fd < 0) return 0;
+    uint32_t key = 0;
+    uint64_t value = 0;
+    bpf_attr attr{};
+    attr.map_fd = map_fd;
+    attr.key = (uint64_t)(uintptr_t)&key;
+    attr.value = (uint64_t)(uintptr_t)&value;
+    if (sys_bpf(BPF_MAP_LOOKUP_ELEM, &attr) < 0) return 0;
+    return value;
+}
+
+// --- Classic BPF ---
+bool ReplyFilter::attach_classic(int fd, const Spec& spec) {
+    // Переходы относительные, поэтому метки считаем от конца: drop — предпоследняя
+    // инструкция, accept — последняя
+    sock_filter code[] = {
+        BPF_STMT(BPF_LD | BPF_B | BPF_ABS, kIpProto),                  // 0
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_TCP, 0, 15),         // 1
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, kIpDaddr),                   // 2
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, spec.local_ip, 0, 13),       // 3
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, kIpSaddr),                   // 4
+        BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, spec.first_ip, 0, 11),       // 5
+        BPF_JUMP(BPF_JMP | BPF_JGT | BPF_K, spec.last_ip, 10, 0),        // 6
+        BPF_STMT(BPF_LD | BPF_H | BPF_ABS, kIpFragOff),                 // 7
+        BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, 0x1fff, 8, 0),              // 8
+        BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, 0),                         // 9: X = длина IP-заголовка
+        BPF_STMT(BPF_LD | BPF_H | BPF_IND, kTcpDport),                  // 10
+        BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, spec.first_port, 0, 5),      // 11
+        BPF_JUMP(BPF_JMP | BPF_JGT | BPF_K, spec.last_port, 4, 0),       // 12
+        BPF_STMT(BPF_LD | BPF_B | BPF_IND, kTcpFlags),                  // 13
+        BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, kFlagRst, 3, 0),            // 14
+        BPF_STMT(BPF_ALU | BPF_AND | BPF_K, kFlagSynAck),               // 15
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, kFlagSynAck, 1, 0),          // 16
+        BPF_STMT(BPF_RET | BPF_K, 0),                                   // 17: drop
+        BPF_STMT(BPF_RET | BPF_K, 0xffffffff),                          // 18: accept
+    };
+    sock_fprog prog{(unsigned short)(sizeof(code) / sizeof(code[0])), code};
+    return setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) == 0;
+}
+
+// --- eBPF: та же логика плюс счётчик отброшенных пакетов в array-map ---
+namespace {
+struct Asm {
+    std::vector<bpf_insn> code;
+
+    void emit(uint8_t op, uint8_t dst, uint8_t src, int16_t off, int32_t imm) {
+        bpf_insn i{};
+        i.code = op;
+        i.dst_reg = dst;
+        i.src_reg = src;
+        i.off = off;
+        i.imm = imm;
+        code.push_back(i);
+    }
+    // 64-битная константа (или fd карты при src = BPF_PSEUDO_MAP_FD) — две инструкции
+    void ld_imm64(uint8_t dst, uint64_t v, uint8_t src = 0) {
+        emit(BPF_LD | BPF_DW | BPF_IMM, dst, src, 0, (int32_t)(uint32_t)v);
+        emit(0, 0, 0, 0, (int32_t)(uint32_t)(v >> 32));
+    }
+    // Условный переход на метку; смещение дописывается в patch()
+    size_t jump(uint8_t op, uint8_t dst, uint8_t src, int32_t imm) {
+        emit(BPF_JMP | op, dst, src, 0, imm);
+        return code.size() - 1;
+    }
+    void patch(const std::vector<size_t>& from, size_t to) {
+        for (size_t i : from) code[i].off = (int16_t)(to - i - 1);
+    }
+};
+}  // namespace
+
+bool ReplyFilter::attach_ebpf(int fd, const Spec& spec) {
+    bpf_attr attr{};
+    attr.map_type = BPF_MAP_TYPE_ARRAY;
+    attr.key_size = sizeof(uint32_t);
+    attr.value_size = sizeof(uint64_t);
+    attr.max_entries = 1;
+    map_fd = (int)sys_bpf(BPF_MAP_CREATE, &attr);
+    if (map_fd < 0) return false;
+
+    // LD_ABS/LD_IND кладут в r0 значение уже в host byte order и требуют ctx в r6
+    Asm a;
+    std::vector<size_t> to_drop, to_accept;
+    a.emit(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_6, BPF_REG_1, 0, 0);
+
+    a.emit(BPF_LD | BPF_B | BPF_ABS, 0, 0, 0, kIpProto);
+    to_drop.push_back(a.jump(BPF_JNE | BPF_K, BPF_REG_0, 0, IPPROTO_TCP));
+    // Адреса сравниваем с регистром: imm в jmp знаково расширяется до 64 бит
+    a.emit(BPF_LD | BPF_W | BPF_ABS, 0, 0, 0, kIpDaddr);
+    a.ld_imm64(BPF_REG_2, spec.local_ip);
+    to_drop.push_back(a.jump(BPF_JNE | BPF_X, BPF_REG_0, BPF_REG_2, 0));
+    a.emit(BPF_LD | BPF_W | BPF_ABS, 0, 0, 0, kIpSaddr);
+    a.ld_imm64(BPF_REG_2, spec.first_ip);
+    to_drop.push_back(a.jump(BPF_JLT | BPF_X, BPF_REG_0, BPF_REG_2, 0));
+    a.ld_imm64(BPF_REG_2, spec.last_ip);
+    to_drop.push_back(a.jump(BPF_JGT | BPF_X, BPF_REG_0, BPF_REG_2, 0));
+    a.emit(BPF_LD | BPF_H | BPF_ABS, 0, 0, 0, kIpFragOff);
+    to_drop.push_back(a.jump(BPF_JSET | BPF_K, BPF_REG_0, 0, 0x1fff));
+
+    // r7 = длина IP-заголовка
+    a.emit(BPF_LD | BPF_B | BPF_ABS, 0, 0, 0, 0);
+    a.emit(BPF_ALU64 | BPF_AND | BPF_K, BPF_REG_0, 0, 0, 0x0f);
+    a.emit(BPF_ALU64 | BPF_LSH | BPF_K, BPF_REG_0, 0, 0, 2);
+    a.emit(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_7, BPF_REG_0, 0, 0);
+
+    a.emit(BPF_LD | BPF_H | BPF_IND, 0, BPF_REG_7, 0, kTcpDport);
+    to_drop.push_back(a.jump(BPF_JLT | BPF_K, BPF_REG_0, 0, spec.first_port));
+    to_drop.push_back(a.jump(BPF_JGT | BPF_K, BPF_REG_0, 0, spec.last_port));
+    a.emit(BPF_LD | BPF_B | BPF_IND, 0, BPF_REG_7, 0, kTcpFlags);
+    to_accept.push_back(a.jump(BPF_JSET | BPF_K, BPF_REG_0, 0, kFlagRst));
+    a.emit(BPF_ALU64 | BPF_AND | BPF_K, BPF_REG_0, 0, 0, kFlagSynAck);
+    to_accept.push_back(a.jump(BPF_JEQ | BPF_K, BPF_REG_0, 0, kFlagSynAck));
+
+    // drop: ++counter[0]; return 0
+    a.patch(to_drop, a.code.size());
+    a.emit(BPF_ST | BPF_MEM | BPF_W, BPF_REG_10, 0, -4, 0);
+    a.emit(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_2, BPF_REG_10, 0, 0);
+    a.emit(BPF_ALU64 | BPF_ADD | BPF_K, BPF_REG_2, 0, 0, -4);
+    a.ld_imm64(BPF_REG_1, (uint32_t)map_fd, BPF_PSEUDO_MAP_FD);
+    a.emit(BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_map_lookup_elem);
+    a.emit(BPF_JMP | BPF_JEQ | BPF_K, BPF_REG_0, 0, 2, 0);
+    a.emit(BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_1, 0, 0, 1);
+    a.emit(BPF_STX | BPF_DW | BPF_ATOMIC, BPF_REG_0, BPF_REG_1, 0, BPF_ADD);
+    a.emit(BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_0, 0, 0, 0);
+    a.emit(BPF_JMP | BPF_EXIT, 0, 0, 0, 0);
+
+    // accept: весь пакет
+    a.patch(to_accept, a.code.size());
+    a.emit(BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_0, 0, 0, -1);
+    a.emit(BPF_JMP | BPF_EXIT, 0, 0, 0, 0);
+
+    static const char license[] = "GPL";
+    std::memset(&attr, 0, sizeof(attr));
+    attr.prog_type = BPF_PROG_TYPE_SOCKET_FILTER;
+    attr.insns = (uint64_t)(uintptr_t)a.code.data();
+    attr.insn_cnt = (uint32_t)a.code.size();
+    attr.license = (uint64_t)(uintptr_t)license;
+    prog_fd = (int)sys_bpf(BPF_PROG_LOAD, &attr);
+
+    if (prog_fd < 0 || setsockopt(fd, SOL_SOCKET, SO_ATTACH_BPF, &prog_fd, sizeof(prog_fd)) < 0) {
+        if (prog_fd >= 0) close(prog_fd);
+        close(map_fd);
+        prog_fd = map_fd = -1;
+        return false;
+    }
+    return true;
+}
+#endif
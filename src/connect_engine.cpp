@@ -0,0 +1,399 @@
+#include "connect_engine.hpp"
+#include "banner.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <thread>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#else
+#include <poll.h>
+#endif
+
+static uint64_t mono_ms() {
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static uint64_t mono_us() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// Поднимаем мягкий лимит дескрипторов до жёсткого: по сокету на пробу в полёте
+static void raise_nofile_limit() {
+    rlimit rl{};
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+}
+
+// --- Конструктор ---
+ConnectEngine::ConnectEngine(int max_inflight, RttEstimator& rtt, int retries, bool grab_banner,
+                             int banner_timeout_ms)
+    : max_inflight(std::max(1, max_inflight)), rtt(rtt), retries(std::clamp(retries, 0, 255)),
+      grab_banner(grab_banner), banner_timeout_ms(std::max(1, banner_timeout_ms)),
+      timers(mono_ms()) {
+    raise_nofile_limit();
+    slots.resize(this->max_inflight);
+    free_slots.reserve(this->max_inflight);
+    for (int i = this->max_inflight - 1; i >= 0; --i) free_slots.push_back(i);
+#ifdef __linux__
+    poll_fd = epoll_create1(EPOLL_CLOEXEC);
+#endif
+}
+
+ConnectEngine::~ConnectEngine() {
+    for (auto& s : slots) {
+        if (s.fd >= 0) close(s.fd);
+    }
+    if (poll_fd >= 0) close(poll_fd);
+}
+
+// Ждём от сокета записи (идёт connect) или чтения (ждём баннер)
+static bool watch(int poll_fd, int fd, uint64_t key, bool readable, bool add) {
+#ifdef __linux__
+    epoll_event ev{};
+    ev.events = readable ? EPOLLIN : EPOLLOUT;
+    ev.data.u64 = key;
+    return epoll_ctl(poll_fd, add ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, fd, &ev) == 0;
+#else
+    (void)poll_fd; (void)fd; (void)key; (void)readable; (void)add;
+    return true; // poll() строит набор заново на каждой итерации
+#endif
+}
+
+// --- Запуск одной пробы ---
+// false — проба уже завершена (или не начата, если fd_exhausted)
+bool ConnectEngine::start(const Retry& r, const DoneFn& done, bool& fd_exhausted) {
+    const ProbeTask& task = r.task;
+    fd_exhausted = false;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+            fd_exhausted = true;
+        } else {
+            done(task, r.probe > 0, "");
+        }
+        return false;
+    }
+    int flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+#ifdef SO_NOSIGPIPE
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(task.port);
+    addr.sin_addr.s_addr = htonl(task.ip);
+
+    uint32_t idx = free_slots.back();
+    free_slots.pop_back();
+    Slot& s = slots[idx];
+    s.fd = fd;
+    s.task = task;
+    s.stage = Stage::CONNECT;
+    s.attempt = r.attempt;
+    s.probe = r.probe;
+    s.started_us = mono_us();
+
+    if (!watch(poll_fd, fd, ((uint64_t)s.gen << 32) | idx, false, true)) {
+        finish(idx, r.probe > 0, done);
+        return false;
+    }
+
+    int rc = connect(fd, (sockaddr*)&addr, sizeof(addr));
+    if (rc == 0) {
+        rtt.sample(task.ip, mono_us() - s.started_us);
+        if (rate) rate->answered(r.attempt);
+        on_connected(idx, done);
+        return true;
+    }
+    if (errno == EADDRNOTAVAIL || errno == EAGAIN) {
+        // закончились локальные порты — отложим пробу до освобождения слотов
+        release(idx);
+        fd_exhausted = true;
+        return false;
+    }
+    if (errno != EINPROGRESS) {
+        finish(idx, r.probe > 0, done);
+        return false;
+    }
+
+    timers.add(mono_ms() + (uint64_t)rtt.timeout_ms(task.ip, r.attempt), ((uint64_t)s.gen << 32) | idx);
+    return true;
+}
+
+// --- Соединение установлено: либо готово, либо переходим к баннеру ---
+void ConnectEngine::on_connected(uint32_t idx, const DoneFn& done) {
+    if (!grab_banner) {
+        finish(idx, true, done);
+        return;
+    }
+    Slot& s = slots[idx];
+    // Новое поколение отсекает таймер connect — иначе он оборвал бы ожидание баннера
+    ++s.gen;
+    const BannerProbe* p = banner_probe(s.task.port, s.probe);
+    if (!p || !watch(poll_fd, s.fd, ((uint64_t)s.gen << 32) | idx, true, false)) {
+        finish(idx, true, done);
+        return;
+    }
+    int greeting = p->greeting_ms == kGreetFull ? banner_timeout_ms
+                                                : std::min(p->greeting_ms, banner_timeout_ms);
+    if (greeting <= 0) {
+        send_probe(idx, done);
+        return;
+    }
+    s.stage = Stage::GREETING;
+    timers.add(mono_ms() + (uint64_t)greeting, ((uint64_t)s.gen << 32) | idx);
+}
+
+// --- Приветствия не было: шлём пробу по тому же соединению ---
+void ConnectEngine::send_probe(uint32_t idx, const DoneFn& done) {
+    Slot& s = slots[idx];
+    // NULL-проба ничего не шлёт, так что следующая идёт по её соединению, без
+    // второго окна приветствия
+    const BannerProbe* p = banner_probe(s.task.port, s.probe);
+    while (p && p->payload.empty()) p = banner_probe(s.task.port, ++s.probe);
+    if (!p) {
+        finish(idx, true, done);
+        return;
+    }
+#ifdef MSG_NOSIGNAL
+    send(s.fd, p->payload.data(), p->payload.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+#else
+    send(s.fd, p->payload.data(), p->payload.size(), MSG_DONTWAIT);
+#endif
+    if (p->kind == ProbeKind::TLS) s.tls = std::make_unique<TlsReader>();
+    s.stage = Stage::RESPONSE;
+    timers.add(mono_ms() + (uint64_t)banner_timeout_ms, ((uint64_t)s.gen << 32) | idx);
+}
+
+// --- Проба осталась без ответа: следующая — на новом соединении ---
+void ConnectEngine::next_probe(uint32_t idx, const DoneFn& done) {
+    Slot& s = slots[idx];
+    uint8_t probe = s.probe + 1;
+    if (!banner_probe(s.task.port, probe)) {
+        finish(idx, true, done); // порт открыт, сервис не опознан
+        return;
+    }
+    retry_queue.push_back({s.task, 0, probe});
+    release(idx);
+}
+
+// --- Пришли данные: приветствие или ответ на пробу ---
+void ConnectEngine::on_readable(uint32_t idx, const DoneFn& done) {
+    Slot& s = slots[idx];
+    char buf[1024];
+    long n = recv(s.fd, buf, sizeof(buf), MSG_DONTWAIT);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return; // ложное пробуждение
+    if (s.tls) {
+        on_tls(idx, buf, n, done);
+        return;
+    }
+    if (n <= 0) {
+        next_probe(idx, done); // сервис закрыл соединение молча
+        return;
+    }
+    append_banner(s.banner, buf, n);
+    finish(idx, true, done);
+}
+
+// --- Ответ TLS-пробы: копим записи, пока не увидим сертификат ---
+void ConnectEngine::on_tls(uint32_t idx, const char* data, long n, const DoneFn& done) {
+    Slot& s = slots[idx];
+    TlsReader& tls = *s.tls;
+    TlsReader::Status st = n > 0 ? tls.feed(data, (size_t)n) : TlsReader::Status::DONE;
+    if (st == TlsReader::Status::MORE) return;
+    if (tls.started()) {
+        s.banner = tls.summary();
+    } else if (st == TlsReader::Status::NOT_TLS) {
+        append_banner(s.banner, tls.raw().data(), (long)tls.raw().size()); // например, HTTP на 443
+    } else {
+        next_probe(idx, done); // закрыли соединение, ничего не ответив
+        return;
+    }
+    finish(idx, true, done);
+}
+
+// --- Завершение пробы и освобождение слота ---
+void ConnectEngine::finish(uint32_t idx, bool open, const DoneFn& done) {
+    Slot& s = slots[idx];
+    release(idx);
+    done(s.task, open, s.banner);
+    s.banner.clear();
+}
+
+// Закрываем сокет; устаревшие таймеры слота отсеются по поколению
+void ConnectEngine::release(uint32_t idx) {
+    Slot& s = slots[idx];
+    close(s.fd); // close() сам снимает fd с epoll
+    s.fd = -1;
+    s.stage = Stage::IDLE;
+    s.tls.reset();
+    ++s.gen;
+    free_slots.push_back(idx);
+}
+
+// --- Сработал таймер слота ---
+void ConnectEngine::expire(uint64_t payload, const DoneFn& done) {
+    uint32_t idx = (uint32_t)(payload & 0xffffffffu);
+    Slot& s = slots[idx];
+    if (s.gen != (uint32_t)(payload >> 32) || s.fd < 0) return;
+
+    if (s.stage == Stage::GREETING) {
+        send_probe(idx, done);
+        return;
+    }
+    if (s.stage == Stage::RESPONSE) {
+        if (s.tls && s.tls->started()) {
+            s.banner = s.tls->summary(); // сертификат не дошёл целиком — что успели
+            finish(idx, true, done);
+        } else {
+            next_probe(idx, done);
+        }
+        return;
+    }
+    // Событие могло не успеть дойти до нас — проверяем состояние сокета напрямую
+    sockaddr_in peer{};
+    socklen_t len = sizeof(peer);
+    if (getpeername(s.fd, (sockaddr*)&peer, &len) == 0) {
+        on_connected(idx, done);
+    } else if (s.attempt < retries) {
+        // SYN или SYN-ACK мог потеряться — пробуем ещё раз с новым сокетом
+        retry_queue.push_back({s.task, (uint8_t)(s.attempt + 1), s.probe});
+        release(idx);
+    } else {
+        // порт фильтруется; при переподключении ради следующей пробы он уже
+        // известен как открытый
+        finish(idx, s.probe > 0, done);
+    }
+}
+
+// --- Основной цикл ---
+void ConnectEngine::run(const NextProbeFn& next, const DoneFn& done, const WaitFn& wait_more) {
+    bool input_done = false;
+    auto on_timer = [&](uint64_t payload) { expire(payload, done); };
+
+    while (true) {
+        // Заполняем свободные слоты: сначала повторы, потом новые пробы
+        bool paced = false;
+        while (!free_slots.empty()) {
+            bool work = !retry_queue.empty() || !input_done;
+            if (rate && work && credit == 0 && (credit = rate->take(kRateChunk)) == 0) {
+                paced = true;
+                break;
+            }
+            Retry r{};
+            if (!retry_queue.empty()) {
+                r = retry_queue.back();
+                retry_queue.pop_back();
+            } else if (input_done || !next(r.task)) {
+                if (!wait_more) input_done = true;
+                break;
+            }
+            bool fd_exhausted = false;
+            start(r, done, fd_exhausted);
+            if (fd_exhausted) {
+                retry_queue.push_back(r);
+                break;
+            }
+            if (rate) --credit;
+        }
+
+        int inflight = max_inflight - (int)free_slots.size();
+        if (inflight == 0) {
+            if (paced) {
+                // Ждём токен; вход и повторы никуда не денутся
+                int wait = std::min(rate->wait_ms(), kInputPollMs);
+                std::this_thread::sleep_for(std::chrono::milliseconds(std::max(wait, 1)));
+                continue;
+            }
+            if (retry_queue.empty()) {
+                if (input_done) break;
+                // вход пуст, но ещё открыт
+                if (!wait_more(100)) input_done = true;
+                continue;
+            }
+            // дескрипторов нет даже при пустом движке — их держат другие потоки
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            continue;
+        }
+
+        int wait_ms = timers.next_timeout_ms(mono_ms());
+        if (wait_more && !input_done && !free_slots.empty() &&
+            (wait_ms < 0 || wait_ms > kInputPollMs)) {
+            wait_ms = kInputPollMs;
+        }
+        if (paced) {
+            int token_ms = std::max(rate->wait_ms(), 1);
+            wait_ms = wait_ms < 0 ? token_ms : std::min(wait_ms, token_ms);
+        }
+
+        auto on_event = [&](uint32_t idx, bool error) {
+            Slot& s = slots[idx];
+            if (s.stage == Stage::CONNECT) {
+                int err = 0;
+                socklen_t len = sizeof(err);
+                getsockopt(s.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+                // SYN-ACK и RST одинаково годятся для замера RTT
+                if (err == 0 || err == ECONNREFUSED) {
+                    rtt.sample(s.task.ip, mono_us() - s.started_us);
+                    if (rate) rate->answered(s.attempt);
+                }
+                if (err == 0 && !error) {
+                    on_connected(idx, done);
+                } else {
+                    finish(idx, s.probe > 0, done);
+                }
+            } else if (s.stage != Stage::IDLE) {
+                on_readable(idx, done);
+            }
+        };
+
+#ifdef __linux__
+        // Выбираем все готовые события, прежде чем смотреть на дедлайны
+        const int kBatch = 256;
+        epoll_event events[kBatch];
+        int n;
+        do {
+            n = epoll_wait(poll_fd, events, kBatch, wait_ms);
+            wait_ms = 0;
+            for (int i = 0; i < n; ++i) {
+                uint32_t idx = (uint32_t)(events[i].data.u64 & 0xffffffffu);
+                uint32_t gen = (uint32_t)(events[i].data.u64 >> 32);
+                if (slots[idx].gen != gen || slots[idx].fd < 0) continue;
+                on_event(idx, false);
+            }
+        } while (n == kBatch);
+#else
+        std::vector<pollfd> pfds;
+        std::vector<uint32_t> idxs;
+        for (uint32_t i = 0; i < slots.size(); ++i) {
+            if (slots[i].fd < 0) continue;
+            short ev = slots[i].stage == Stage::CONNECT ? POLLOUT : POLLIN;
+            pfds.push_back({slots[i].fd, ev, 0});
+            idxs.push_back(i);
+        }
+        int n = poll(pfds.data(), pfds.size(), wait_ms);
+        for (size_t i = 0; n > 0 && i < pfds.size(); ++i) {
+            if (!pfds[i].revents || slots[idxs[i]].fd != pfds[i].fd) continue;
+            bool error = slots[idxs[i]].stage == Stage::CONNECT &&
+                         (pfds[i].revents & (POLLERR | POLLHUP));
+            on_event(idxs[i], error);
+        }
+#endif
+
+        timers.advance(mono_ms(), on_timer);
+    }
+}
@@ -0,0 +1,389 @@
+#include "discovery.hpp"
+
+#ifdef __linux__
+#include "packet_template.hpp"
+#include "permutation.hpp"
+#include "utils.hpp"
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/ip_icmp.h>
+#include <netinet/tcp.h>
+#include <net/if.h>
+#include <net/if_arp.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <arpa/inet.h>
+#include <ifaddrs.h>
+#include <poll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <thread>
+
+// Пакетов на один вызов sendmmsg()
+static const int kSendBatch = 256;
+// Сколько ждать освобождения буфера отправки, прежде чем бросить пакет
+static const uint64_t kSendStallMs = 200;
+// Порты TCP-пингов: SYN на частые сервисы, ACK проходит stateless-фильтры
+static const uint16_t kSynPorts[] = {22, 80, 443, 3389};
+static const uint16_t kAckPort = 80;
+// Порт источника TCP-пингов берётся выше эфемерных портов ядра и SYN-движка
+static const uint16_t kPingPortBase = 61000;
+static const uint16_t kPingPortRange = 4000;
+
+static const size_t kEchoLen = sizeof(icmphdr) + sizeof(uint64_t);
+static const size_t kArpLen = 28;
+
+static uint64_t mono_ms() {
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static uint64_t mono_us() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static uint16_t icmp_checksum(const uint8_t* p, size_t n) {
+    uint32_t sum = 0;
+    for (size_t i = 0; i + 1 < n; i += 2) sum += (uint32_t)(p[i] << 8 | p[i + 1]);
+    if (n & 1) sum += (uint32_t)p[n - 1] << 8;
+    while (sum >> 16) sum = (sum & 0xffff) + (sum >> 16);
+    return htons((uint16_t)~sum);
+}
+
+void HostDiscovery::Batch::init(int fd, size_t packet_len) {
+    this->fd = fd;
+    this->packet_len = packet_len;
+    n = 0;
+    packets.assign(kSendBatch * packet_len, 0);
+    dsts.resize(kSendBatch);
+    iovs.resize(kSendBatch);
+    msgs.resize(kSendBatch);
+}
+
+// --- Конструктор ---
+HostDiscovery::HostDiscovery(const TargetSet& targets, RttEstimator& rtt, int rounds,
+                             int wait_ms, uint64_t seed)
+    : targets(targets), rtt(rtt), rounds(std::max(1, rounds)), wait_ms(std::max(0, wait_ms)),
+      seed(seed) {
+    std::random_device rd;
+    echo_id = (uint16_t)rd();
+    sport = kPingPortBase + (uint16_t)(rd() % kPingPortRange);
+    key = rd();
+}
+
+HostDiscovery::~HostDiscovery() {
+    for (int fd : {icmp_fd, raw_fd, tcp_fd, arp_fd}) {
+        if (fd >= 0) close(fd);
+    }
+}
+
+bool HostDiscovery::open() {
+    if (targets.empty()) return false;
+    src_ip = route_source_ip(targets.first_ip());
+
+    icmp_fd = socket(AF_INET, SOCK_RAW | SOCK_NONBLOCK, IPPROTO_ICMP);
+    if (icmp_fd < 0) return false;
+    raw_fd = socket(AF_INET, SOCK_RAW, IPPROTO_RAW);
+    if (raw_fd < 0) return false;
+    tcp_fd = socket(AF_INET, SOCK_RAW | SOCK_NONBLOCK, IPPROTO_TCP);
+    if (tcp_fd < 0) return false;
+
+    int sndbuf = 4 << 20;
+    int rcvbuf = 8 << 20;
+    int on = 1;
+    setsockopt(icmp_fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+    setsockopt(icmp_fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    setsockopt(raw_fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+    setsockopt(tcp_fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    // Как у SYN-движка: без IP_RECVERR переполненная очередь устройства не видна
+    setsockopt(icmp_fd, SOL_IP, IP_RECVERR, &on, sizeof(on));
+    setsockopt(raw_fd, SOL_IP, IP_RECVERR, &on, sizeof(on));
+
+    // Свои подсети: IPv4-адрес и маска от AF_INET, MAC — от записи AF_PACKET
+    ifaddrs* ifs = nullptr;
+    if (getifaddrs(&ifs) == 0) {
+        for (ifaddrs* a = ifs; a; a = a->ifa_next) {
+            if (!a->ifa_addr || !a->ifa_netmask || a->ifa_addr->sa_family != AF_INET) continue;
+            if (!(a->ifa_flags & IFF_UP) || (a->ifa_flags & (IFF_LOOPBACK | IFF_NOARP))) continue;
+            Link link{};
+            link.ip = ntohl(((sockaddr_in*)a->ifa_addr)->sin_addr.s_addr);
+            link.mask = ntohl(((sockaddr_in*)a->ifa_netmask)->sin_addr.s_addr);
+            link.ifindex = (int)if_nametoindex(a->ifa_name);
+            bool have_mac = false;
+            for (ifaddrs* b = ifs; b; b = b->ifa_next) {
+                if (!b->ifa_addr || b->ifa_addr->sa_family != AF_PACKET) continue;
+                if (std::strcmp(a->ifa_name, b->ifa_name) != 0) continue;
+                auto* ll = (sockaddr_ll*)b->ifa_addr;
+                if (ll->sll_halen != 6) continue;
+                std::memcpy(link.mac, ll->sll_addr, 6);
+                have_mac = true;
+            }
+            if (have_mac && link.ifindex > 0) links.push_back(link);
+        }
+        freeifaddrs(ifs);
+    }
+
+    // Нет ARP-сокета — свои подсети пингуются как все остальные
+    if (!links.empty()) {
+        arp_fd = socket(AF_PACKET, SOCK_DGRAM | SOCK_NONBLOCK, htons(ETH_P_ARP));
+        if (arp_fd < 0) {
+            links.clear();
+        } else {
+            setsockopt(arp_fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+        }
+    }
+
+    icmp_batch.init(icmp_fd, kEchoLen);
+    tcp_batch.init(raw_fd, kSynPacketLen);
+    arp_batch.init(arp_fd, kArpLen);
+    return true;
+}
+
+// Подсеть интерфейса, в которой лежит ip; свой же адрес — не сосед
+const HostDiscovery::Link* HostDiscovery::link_for(uint32_t ip) const {
+    for (const auto& l : links) {
+        if ((ip & l.mask) == (l.ip & l.mask) && ip != l.ip) return &l;
+    }
+    return nullptr;
+}
+
+// seq TCP-пинга: ответ на чужой SYN не примем за свой
+uint32_t HostDiscovery::cookie(uint32_t ip) const {
+    uint64_t x = ((uint64_t)ip << 32 | key) * 0x9e3779b97f4a7c15ULL;
+    return (uint32_t)(x >> 32);
+}
+
+bool HostDiscovery::mark(uint32_t ip) {
+    uint64_t index = 0;
+    if (!targets.index_of(ip, index) || is_alive(index)) return false;
+    bits[index / 64] |= 1ULL << (index % 64);
+    ++alive_count;
+    return true;
+}
+
+// --- Сборка пакетов ---
+uint8_t* HostDiscovery::slot(Batch& b, const void* dst, socklen_t len) {
+    pace();
+    if (b.n == kSendBatch) flush(b);
+    int i = b.n++;
+    uint8_t* pkt = &b.packets[i * b.packet_len];
+    std::memcpy(&b.dsts[i], dst, len);
+    b.iovs[i] = {pkt, b.packet_len};
+    b.msgs[i] = {};
+    b.msgs[i].msg_hdr.msg_name = &b.dsts[i];
+    b.msgs[i].msg_hdr.msg_namelen = len;
+    b.msgs[i].msg_hdr.msg_iov = &b.iovs[i];
+    b.msgs[i].msg_hdr.msg_iovlen = 1;
+    return pkt;
+}
+
+// Время отправки едет в самом echo и возвращается в ответе — замер RTT без таблицы
+void HostDiscovery::queue_echo(uint32_t ip) {
+    sockaddr_in dst{};
+    dst.sin_family = AF_INET;
+    dst.sin_addr.s_addr = htonl(ip);
+    uint8_t* pkt = slot(icmp_batch, &dst, sizeof(dst));
+    auto* icmp = (icmphdr*)pkt;
+    *icmp = {};
+    icmp->type = ICMP_ECHO;
+    icmp->un.echo.id = htons(echo_id);
+    uint64_t sent_us = mono_us();
+    std::memcpy(pkt + sizeof(icmphdr), &sent_us, sizeof(sent_us));
+    icmp->checksum = icmp_checksum(pkt, kEchoLen);
+}
+
+void HostDiscovery::queue_tcp(uint32_t ip, uint16_t port, uint8_t flags) {
+    sockaddr_in dst{};
+    dst.sin_family = AF_INET;
+    dst.sin_addr.s_addr = htonl(ip);
+    uint8_t* pkt = slot(tcp_batch, &dst, sizeof(dst));
+    build_syn_packet(pkt, src_ip, ip, sport, port, cookie(ip), flags);
+}
+
+// ARP-запрос who-has ip широковещательно в сегмент интерфейса
+void HostDiscovery::queue_arp(const Link& link, uint32_t ip) {
+    sockaddr_ll dst{};
+    dst.sll_family = AF_PACKET;
+    dst.sll_protocol = htons(ETH_P_ARP);
+    dst.sll_ifindex = link.ifindex;
+    dst.sll_halen = 6;
+    std::memset(dst.sll_addr, 0xff, 6);
+    uint8_t* pkt = slot(arp_batch, &dst, sizeof(dst));
+
+    auto* arp = (arphdr*)pkt;
+    arp->ar_hrd = htons(ARPHRD_ETHER);
+    arp->ar_pro = htons(ETH_P_IP);
+    arp->ar_hln = 6;
+    arp->ar_pln = 4;
+    arp->ar_op = htons(ARPOP_REQUEST);
+    uint8_t* p = pkt + sizeof(arphdr);
+    uint32_t spa = htonl(link.ip);
+    uint32_t tpa = htonl(ip);
+    std::memcpy(p, link.mac, 6);
+    std::memcpy(p + 6, &spa, 4);
+    std::memset(p + 10, 0, 6);
+    std::memcpy(p + 16, &tpa, 4);
+}
+
+void HostDiscovery::probe(uint32_t ip) {
+    if (const Link* link = link_for(ip)) {
+        queue_arp(*link, ip);
+        return;
+    }
+    queue_echo(ip);
+    for (uint16_t port : kSynPorts) queue_tcp(ip, port, kTcpSyn);
+    queue_tcp(ip, kAckPort, kTcpAck);
+}
+
+// --- Отправка пачки: MSG_DONTWAIT, частичные отправки досылаются ---
+void HostDiscovery::flush(Batch& b) {
+    int sent = 0;
+    uint64_t stalled_since = 0;
+    while (sent < b.n) {
+        int r = sendmmsg(b.fd, &b.msgs[sent], b.n - sent, MSG_DONTWAIT);
+        if (r > 0) {
+            sent += r;
+            stalled_since = 0;
+        } else if (errno == ENOBUFS || errno == EAGAIN || errno == EINTR) {
+            uint64_t now = mono_ms();
+            if (stalled_since == 0) {
+                stalled_since = now;
+                if (rate && errno == ENOBUFS) rate->dropped(1);
+            }
+            if (now - stalled_since < kSendStallMs) {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+                continue;
+            }
+            ++discovery_stats.send_failures;
+            discovery_stats.last_error = errno;
+            ++sent;
+            stalled_since = 0;
+        } else {
+            // EHOSTUNREACH, EPERM от файрвола и т.п. — теряем голову пачки
+            ++discovery_stats.send_failures;
+            discovery_stats.last_error = errno;
+            ++sent;
+        }
+    }
+    b.n = 0;
+}
+
+void HostDiscovery::flush_all() {
+    if (icmp_batch.n) flush(icmp_batch);
+    if (tcp_batch.n) flush(tcp_batch);
+    if (arp_batch.n) flush(arp_batch);
+}
+
+void HostDiscovery::pace() {
+    if (!rate) return;
+    while (credit == 0 && (credit = rate->take(kRateChunk)) == 0) {
+        // Накопленное уходит сейчас, а не пачкой после паузы
+        flush_all();
+        poll_replies(std::clamp(rate->wait_ms(), 1, 10));
+    }
+    --credit;
+}
+
+// --- Приём ---
+void HostDiscovery::poll_replies(int timeout_ms) {
+    pollfd fds[3] = {{icmp_fd, POLLIN, 0}, {tcp_fd, POLLIN, 0}, {arp_fd, POLLIN, 0}};
+    nfds_t nfds = arp_fd >= 0 ? 3 : 2;
+    if (poll(fds, nfds, timeout_ms) <= 0) return;
+    if (fds[0].revents & POLLIN) drain_icmp();
+    if (fds[1].revents & POLLIN) drain_tcp();
+    if (nfds > 2 && (fds[2].revents & POLLIN)) drain_arp();
+}
+
+// Echo reply с нашим id или unreachable, который хост прислал сам о себе
+void HostDiscovery::drain_icmp() {
+    uint8_t buf[1500];
+    ssize_t n;
+    while ((n = recv(icmp_fd, buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+        auto* outer = (const iphdr*)buf;
+        size_t off = outer->ihl * 4;
+        if ((size_t)n < off + sizeof(icmphdr)) continue;
+        auto* icmp = (const icmphdr*)(buf + off);
+        uint32_t from = ntohl(outer->saddr);
+
+        if (icmp->type == ICMP_ECHOREPLY) {
+            if (ntohs(icmp->un.echo.id) != echo_id || (size_t)n < off + kEchoLen) continue;
+            if (!mark(from)) continue;
+            ++discovery_stats.by_icmp;
+            uint64_t sent_us = 0;
+            std::memcpy(&sent_us, buf + off + sizeof(icmphdr), sizeof(sent_us));
+            uint64_t now = mono_us();
+            if (sent_us <= now) rtt.sample(from, now - sent_us);
+        } else if (icmp->type == ICMP_DEST_UNREACH) {
+            if ((size_t)n < off + sizeof(icmphdr) + sizeof(iphdr)) continue;
+            auto* inner = (const iphdr*)(buf + off + sizeof(icmphdr));
+            // От маршрутизатора (host unreachable) — о жизни хоста ничего не говорит
+            if (inner->daddr != outer->saddr) continue;
+            if (inner->protocol != IPPROTO_ICMP && inner->protocol != IPPROTO_TCP) continue;
+            if (mark(from)) ++discovery_stats.by_icmp;
+        }
+    }
+}
+
+// SYN-ACK или RST на наш TCP-пинг
+void HostDiscovery::drain_tcp() {
+    uint8_t buf[1500];
+    ssize_t n;
+    while ((n = recv(tcp_fd, buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+        auto* ip = (const iphdr*)buf;
+        size_t off = ip->ihl * 4;
+        if ((size_t)n < off + sizeof(tcphdr)) continue;
+        auto* tcp = (const tcphdr*)(buf + off);
+        if (ntohs(tcp->dest) != sport) continue;
+        uint32_t from = ntohl(ip->saddr);
+        // Ответ на SYN подтверждает наш seq; RST на ACK несёт seq = нашему ack_seq = 0
+        bool syn_reply = (tcp->syn || tcp->rst) && tcp->ack && ntohl(tcp->ack_seq) == cookie(from) + 1;
+        bool ack_reply = tcp->rst && ntohs(tcp->source) == kAckPort && tcp->seq == 0;
+        if (!syn_reply && !ack_reply) continue;
+        if (mark(from)) ++discovery_stats.by_tcp;
+    }
+}
+
+// ARP reply (или собственный запрос хоста) с адресом цели в spa
+void HostDiscovery::drain_arp() {
+    uint8_t buf[256];
+    ssize_t n;
+    while ((n = recv(arp_fd, buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+        if ((size_t)n < kArpLen) continue;
+        auto* arp = (const arphdr*)buf;
+        if (ntohs(arp->ar_pro) != ETH_P_IP || arp->ar_hln != 6 || arp->ar_pln != 4) continue;
+        uint32_t spa = 0;
+        std::memcpy(&spa, buf + sizeof(arphdr) + 6, 4);
+        if (mark(ntohl(spa))) ++discovery_stats.by_arp;
+    }
+}
+
+// --- Проходы по хостам без ответа, между ними — ожидание wait_ms ---
+TargetSet HostDiscovery::run() {
+    uint64_t total = targets.size();
+    bits.assign((total + 63) / 64, 0);
+    Permutation perm(total, seed);
+
+    for (int round = 0; round < rounds && alive_count < total; round++) {
+        for (uint64_t k = 0; k < total && alive_count < total; k++) {
+            uint64_t index = perm.at(k);
+            if (is_alive(index)) continue;
+            probe(targets.at(index));
+            // Ответы разбираем по ходу, чтобы не переполнить буферы приёма
+            if (k % kSendBatch == kSendBatch - 1) poll_replies(0);
+        }
+        flush_all();
+
+        uint64_t deadline = mono_ms() + (uint64_t)wait_ms;
+        uint64_t now;
+        while (alive_count < total && (now = mono_ms()) < deadline) {
+            poll_replies((int)std::min<uint64_t>(deadline - now, 50));
+        }
+    }
+    return targets.subset([this](uint64_t index) { return is_alive(index); });
+}
+#endif
@@ -0,0 +1,336 @@
+#include "fingerprint.hpp"
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+// --- Встроенные сигнатуры ---
+// Частные правила идут раньше общих для того же сервиса. Заголовок Server
+// ищется без якоря: [\s\S]* от начала ответа в std::regex дорого откатывается
+static const char* const kBuiltinSignatures = R"SIG(
+# service   product          /regex/flags
+ssh         OpenSSH          /^SSH-[\d.]+-OpenSSH_([\w.]+)/
+ssh         Dropbear         /^SSH-[\d.]+-dropbear_([\w.]+)/
+ssh         -                /^SSH-[\d.]+-/
+ftp         vsftpd           /^220 \(vsFTPd ([\d.]+)\)/
+ftp         ProFTPD          /^220 ProFTPD ([\d.]+)/
+ftp         Pure-FTPd        /^220[ -][^\r\n]*Pure-FTPd/
+ftp         FileZilla        /^220[ -][^\r\n]*FileZilla Server(?: version)? ([\d.]+)/i
+smtp        Postfix          /^220 [^\r\n]* ESMTP Postfix/
+smtp        Exim             /^220 [^\r\n]* ESMTP Exim ([\d.]+)/
+smtp        Sendmail         /^220 [^\r\n]* ESMTP Sendmail ([\w.\/]+)/
+smtp        -                /^220[ -][^\r\n]*SMTP/i
+ftp         -                /^220[ -][^\r\n]*FTP/i
+pop3        Dovecot          /^\+OK [^\r\n]*Dovecot/
+pop3        -                /^\+OK/
+imap        Dovecot          /^\* OK [^\r\n]*Dovecot/
+imap        -                /^\* OK [^\r\n]*IMAP/i
+http        nginx            /\r\nServer: nginx(?:\/([\d.]+))?/i
+http        "Apache httpd"   /\r\nServer: Apache(?:\/([\d.]+))?/i
+http        "Microsoft IIS"  /\r\nServer: Microsoft-IIS\/([\d.]+)/i
+http        lighttpd         /\r\nServer: lighttpd(?:\/([\d.]+))?/i
+http        Caddy            /\r\nServer: Caddy/i
+http        SimpleHTTPServer /\r\nServer: SimpleHTTP\/([\d.]+)/
+ssdp        -                /\r\nUSN: uuid:/i
+http        -                /^HTTP\/1\.[01] \d{3}/
+rtsp        -                /^RTSP\/1\.0 \d{3}/
+tls         -                /^(?:TLS|SSL)v?([\d.]+)? /
+redis       -                /^(?:\+PONG|-NOAUTH|-DENIED)/
+memcached   -                /^(?:[\s\S]{8})?VERSION ([\d.]+)/
+mysql       MariaDB          /^[\s\S]{4}\x0a(?:5\.5\.5-)?([\d.]+)-MariaDB/
+mysql       MySQL            /^[\s\S]{4}\x0a([\d.]+[\w.-]*)\x00/
+postgresql  -                /^[SN]$/
+vnc         -                /^RFB (\d{3}\.\d{3})\n/
+dns         -                /^(?:[\s\S]{2})?\x00\x06[\x80-\xff]/
+ntp         -                /^[\x14\x1c\x24\x54\x5c\x64\x94\x9c\xa4\xd4\xdc\xe4][\x00-\x10][\s\S]{46}$/
+snmp        -                /^\x30[\s\S]{1,3}\x02\x01[\x00\x01]\x04/
+isakmp      -                /^\x11\x22\x33\x44\x55\x66\x77\x88/
+netbios-ns  -                /^\x80\xf0[\x84\x85]/
+irc         -                /^:[^\s]+ NOTICE /
+telnet      -                /^\xff[\xfb-\xfe]/
+)SIG";
+
+bool Fingerprints::load_builtin(std::string& err) {
+    return compile(kBuiltinSignatures, "builtin", err);
+}
+
+bool Fingerprints::load_file(const std::string& path, std::string& err) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        err = path + ": cannot open";
+        return false;
+    }
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return compile(ss.str(), path, err);
+}
+
+// --- Разбор файла сигнатур ---
+static std::string_view trim(std::string_view s) {
+    size_t b = s.find_first_not_of(" \t\r");
+    if (b == std::string_view::npos) return {};
+    return s.substr(b, s.find_last_not_of(" \t\r") - b + 1);
+}
+
+// Слово до пробела или "строка в кавычках"; s сдвигается за него
+static bool take_field(std::string_view& s, std::string& out) {
+    s = trim(s);
+    if (s.empty()) return false;
+    size_t end;
+    if (s[0] == '"') {
+        end = s.find('"', 1);
+        if (end == std::string_view::npos) return false;
+        out = std::string(s.substr(1, end - 1));
+        ++end;
+    } else {
+        end = std::min(s.find_first_of(" \t"), s.size());
+        out = std::string(s.substr(0, end));
+    }
+    s.remove_prefix(end);
+    return true;
+}
+
+static char ascii_lower(int c) {
+    return (char)(c >= 'A' && c <= 'Z' ? c + 32 : c);
+}
+
+static int hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    c = ascii_lower(c);
+    return c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+}
+
+// Самый длинный литерал, который есть в любом совпадении regex, в нижнем
+// регистре. Смотрим только верхний уровень: группы, классы и атомы с
+// квантификатором, допускающим ноль повторов, рвут литерал, а альтернатива
+// на верхнем уровне оставляет правило без литерала.
+static std::string required_literal(std::string_view re) {
+    std::string best, cur;
+    auto cut = [&] {
+        if (cur.size() > best.size()) best = cur;
+        cur.clear();
+    };
+    size_t n = re.size(), i = 0;
+    int depth = 0;
+    while (i < n) {
+        char c = re[i];
+        if (c == '[') {
+            ++i;
+            if (i < n && re[i] == '^') ++i;
+            if (i < n && re[i] == ']') ++i;
+            while (i < n && re[i] != ']') i += re[i] == '\\' ? 2 : 1;
+            ++i;
+            if (depth == 0) cut();
+            continue;
+        }
+        if (c == '(') {
+            ++depth;
+            cut();
+            ++i;
+            continue;
+        }
+        if (c == ')') {
+            --depth;
+            ++i;
+            continue;
+        }
+        if (c == '|' && depth == 0) return "";
+        if (depth > 0) {
+            i += c == '\\' ? 2 : 1;
+            continue;
+        }
+        if (c == '*' || c == '+' || c == '?') {
+            cut();
+            ++i;
+            continue;
+        }
+        if (c == '{') {
+            cut();
+            while (i < n && re[i] != '}') ++i;
+            ++i;
+            continue;
+        }
+
+        // Атом: литеральный байт или -1 (., ^, $, \d, \w, \b...)
+        int lit = -1;
+        size_t len = 1;
+        if (c == '\\' && i + 1 < n) {
+            char e = re[i + 1];
+            len = 2;
+            if (e == 'r') {
+                lit = '\r';
+            } else if (e == 'n') {
+                lit = '\n';
+            } else if (e == 't') {
+                lit = '\t';
+            } else if (e == 'x' && i + 3 < n && hex_digit(re[i + 2]) >= 0 && hex_digit(re[i + 3]) >= 0) {
+                lit = hex_digit(re[i + 2]) * 16 + hex_digit(re[i + 3]);
+                len = 4;
+            } else if (!std::isalnum((unsigned char)e)) {
+                lit = (unsigned char)e;
+            }
+        } else if (c != '.' && c != '^' && c != '$') {
+            lit = (unsigned char)c;
+        }
+        i += len;
+        char q = i < n ? re[i] : 0;
+        if (lit < 0 || q == '*' || q == '?' || q == '{') {
+            cut();
+            continue;
+        }
+        cur += ascii_lower(lit);
+        if (q == '+') cut(); // повторы атома уже не подряд с тем, что дальше
+    }
+    cut();
+    return best;
+}
+
+bool Fingerprints::compile(std::string_view text, const std::string& name, std::string& err) {
+    rules.clear();
+    always.clear();
+    std::vector<std::string> literals;
+    size_t line_no = 0;
+    while (!text.empty()) {
+        size_t eol = std::min(text.find('\n'), text.size());
+        std::string_view line = trim(text.substr(0, eol));
+        text.remove_prefix(std::min(eol + 1, text.size()));
+        ++line_no;
+        if (line.empty() || line[0] == '#') continue;
+
+        auto fail = [&](const std::string& why) {
+            err = name + ":" + std::to_string(line_no) + ": " + why;
+            return false;
+        };
+        Rule rule;
+        if (!take_field(line, rule.service) || !take_field(line, rule.product)) {
+            return fail("expected: service product /regex/flags");
+        }
+        if (rule.product == "-") rule.product.clear();
+        line = trim(line);
+        size_t close = line.rfind('/');
+        if (line.empty() || line[0] != '/' || close == 0) return fail("regex must be /.../");
+        std::string pattern(line.substr(1, close - 1));
+        auto flags = std::regex::ECMAScript | std::regex::optimize;
+        for (char f : line.substr(close + 1)) {
+            if (f != 'i') return fail(std::string("unknown flag '") + f + "'");
+            flags |= std::regex::icase;
+        }
+        rule.anchored = !pattern.empty() && pattern[0] == '^';
+        try {
+            rule.re = std::regex(pattern, flags);
+        } catch (const std::regex_error& e) {
+            return fail(std::string("bad regex: ") + e.what());
+        }
+
+        std::string lit = required_literal(pattern);
+        if (lit.size() < kMinLiteral) {
+            always.push_back((uint32_t)rules.size());
+            lit.clear();
+        }
+        literals.push_back(std::move(lit));
+        rules.push_back(std::move(rule));
+    }
+    build(literals);
+    return true;
+}
+
+// --- Автомат Ахо-Корасик ---
+// Бор литералов, затем обход в ширину: ссылки неудач сразу сворачиваются в
+// полную таблицу переходов, так что при поиске на байт один переход без циклов
+void Fingerprints::build(const std::vector<std::string>& literals) {
+    std::fill(std::begin(byte_class), std::end(byte_class), 0);
+    class_count = 1;
+    for (const auto& lit : literals) {
+        for (unsigned char c : lit) {
+            if (!byte_class[c]) byte_class[c] = (uint8_t)class_count++;
+        }
+    }
+    for (int c = 'a'; c <= 'z'; c++) byte_class[c - 32] = byte_class[c];
+    const uint32_t C = class_count;
+
+    std::vector<uint32_t> go(C, 0);  // 0 — перехода нет (в корень не ведёт ни одно ребро)
+    std::vector<std::vector<uint32_t>> own(1);
+    for (uint32_t id = 0; id < literals.size(); id++) {
+        if (literals[id].empty()) continue;
+        uint32_t s = 0;
+        for (unsigned char c : literals[id]) {
+            uint32_t cls = byte_class[c];
+            if (!go[s * C + cls]) {
+                uint32_t next = (uint32_t)own.size();
+                go[s * C + cls] = next;
+                go.resize(go.size() + C, 0);
+                own.emplace_back();
+            }
+            s = go[s * C + cls];
+        }
+        own[s].push_back(id);
+    }
+
+    size_t states = own.size();
+    delta = go;
+    std::vector<uint32_t> fail(states, 0), order;
+    order.reserve(states);
+    order.push_back(0);
+    for (size_t head = 0; head < order.size(); head++) {
+        uint32_t u = order[head];
+        for (uint32_t c = 0; c < C; c++) {
+            uint32_t v = go[u * C + c];
+            if (v) {
+                fail[v] = u ? delta[fail[u] * C + c] : 0;
+                order.push_back(v);
+            } else if (u) {
+                delta[u * C + c] = delta[fail[u] * C + c];
+            }
+        }
+    }
+
+    // Правила состояния — свои и всех суффиксов (по цепочке неудач)
+    std::vector<std::vector<uint32_t>> outs(states);
+    for (uint32_t s : order) {
+        outs[s] = own[s];
+        if (s) outs[s].insert(outs[s].end(), outs[fail[s]].begin(), outs[fail[s]].end());
+    }
+    out_begin.assign(states + 1, 0);
+    out_rules.clear();
+    for (size_t s = 0; s < states; s++) {
+        out_begin[s] = (uint32_t)out_rules.size();
+        out_rules.insert(out_rules.end(), outs[s].begin(), outs[s].end());
+    }
+    out_begin[states] = (uint32_t)out_rules.size();
+}
+
+// --- Поиск ---
+bool Fingerprints::match(std::string_view banner, ServiceInfo& out) const {
+    if (rules.empty() || banner.empty()) return false;
+
+    // Кандидаты: правила, чей литерал встретился, и правила без литерала
+    thread_local std::vector<uint32_t> hits;
+    thread_local std::cmatch m;
+    hits.clear();
+    uint32_t s = 0;
+    for (unsigned char c : banner) {
+        s = delta[s * class_count + byte_class[c]];
+        for (uint32_t k = out_begin[s]; k < out_begin[s + 1]; k++) hits.push_back(out_rules[k]);
+    }
+    hits.insert(hits.end(), always.begin(), always.end());
+    std::sort(hits.begin(), hits.end());
+    hits.erase(std::unique(hits.begin(), hits.end()), hits.end());
+
+    for (uint32_t id : hits) {
+        const Rule& r = rules[id];
+        // libstdc++ иначе перезапускает якорный regex с каждой позиции баннера
+        auto how = r.anchored ? std::regex_constants::match_continuous
+                              : std::regex_constants::match_default;
+        if (!std::regex_search(banner.data(), banner.data() + banner.size(), m, r.re, how)) continue;
+        out.service = r.service;
+        out.product = r.product;
+        if (m.size() > 1 && m[1].matched) {
+            out.version = m[1].str();
+        } else {
+            out.version.clear();
+        }
+        return true;
+    }
+    return false;
+}
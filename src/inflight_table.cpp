@@ -0,0 +1,139 @@
+#include "inflight_table.hpp"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <cstdint>
+#include <new>
+
+static const uint64_t kUsed = 0x01;
+static const uint64_t kAnswered = 0x02;
+
+static uint64_t make_key(uint32_t ip, uint16_t port) {
+    return ((uint64_t)ip << 32) | ((uint64_t)port << 16);
+}
+
+static uint64_t key_of(uint64_t word) { return word & ~0xffffULL; }
+static uint8_t attempt_of(uint64_t word) { return (uint8_t)(word >> 8); }
+
+static uint64_t mix64(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// --- Выделение: ёмкость — степень двойки не меньше 2 * max_entries ---
+InflightTable::InflightTable(size_t max_entries) : max_entries(max_entries ? max_entries : 1) {
+    size_t slots = 16;
+    while (slots < 2 * this->max_entries) slots <<= 1;
+    mask = slots - 1;
+
+    // Явные huge pages (если администратор их выделил), иначе обычная память
+    // с подсказкой для transparent huge pages. Анонимный mmap уже обнулён.
+    const size_t kHuge = 2 << 20;
+    bytes = (slots * sizeof(Entry) + kHuge - 1) / kHuge * kHuge;
+    void* mem = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    hugetlb = mem != MAP_FAILED;
+    if (!hugetlb) {
+        mem = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED) throw std::bad_alloc();
+#ifdef MADV_HUGEPAGE
+        madvise(mem, bytes, MADV_HUGEPAGE);
+#endif
+    }
+    table = (Entry*)mem;
+}
+
+InflightTable::~InflightTable() {
+    if (table) munmap(table, bytes);
+}
+
+size_t InflightTable::home(uint64_t key) const {
+    return mix64(key) & mask;
+}
+
+size_t InflightTable::find(uint64_t key) const {
+    for (size_t i = home(key);; i = (i + 1) & mask) {
+        uint64_t w = table[i].word.load(std::memory_order_acquire);
+        if (w == 0) return SIZE_MAX;
+        if (key_of(w) == key) return i;
+    }
+}
+
+// --- Поток отправки ---
+bool InflightTable::insert(uint32_t ip, uint16_t port, uint64_t sent_us) {
+    if (full()) return false;
+    uint64_t key = make_key(ip, port);
+    size_t i = home(key);
+    while (table[i].word.load(std::memory_order_relaxed) != 0) i = (i + 1) & mask;
+    table[i].sent_us.store(sent_us, std::memory_order_relaxed);
+    table[i].word.store(key | kUsed, std::memory_order_release);
+    ++live;
+    return true;
+}
+
+bool InflightTable::lookup(uint32_t ip, uint16_t port, uint8_t& attempt, bool& answered) const {
+    size_t i = find(make_key(ip, port));
+    if (i == SIZE_MAX) return false;
+    uint64_t w = table[i].word.load(std::memory_order_acquire);
+    attempt = attempt_of(w);
+    answered = w & kAnswered;
+    return true;
+}
+
+bool InflightTable::retry(uint32_t ip, uint16_t port, uint8_t attempt, uint64_t sent_us) {
+    size_t i = find(make_key(ip, port));
+    if (i == SIZE_MAX) return false;
+    uint64_t w = table[i].word.load(std::memory_order_acquire);
+    if (w & kAnswered) return false;
+    table[i].sent_us.store(sent_us, std::memory_order_relaxed);
+    uint64_t next = key_of(w) | ((uint64_t)attempt << 8) | kUsed;
+    // Проиграли гонку с потоком приёма — проба уже отвечена
+    return table[i].word.compare_exchange_strong(w, next, std::memory_order_acq_rel);
+}
+
+// Удаление обратным сдвигом: записи цепочки за дыркой, которые могут в неё
+// переехать, не нарушив порядок пробирования, сдвигаются назад
+void InflightTable::erase(uint32_t ip, uint16_t port) {
+    size_t hole = find(make_key(ip, port));
+    if (hole == SIZE_MAX) return;
+    --live;
+
+    for (size_t j = (hole + 1) & mask;; j = (j + 1) & mask) {
+        uint64_t w = table[j].word.load(std::memory_order_acquire);
+        if (w == 0) break;
+        size_t h = home(key_of(w));
+        // Запись из j может занять hole, только если её домашняя ячейка
+        // не лежит циклически в (hole, j]
+        bool movable = hole <= j ? (h <= hole || h > j) : (h <= hole && h > j);
+        if (!movable) continue;
+
+        // Копия в дырку, затем CAS старого места: если поток приёма успел
+        // пометить запись, копируем заново с его флагом
+        table[hole].sent_us.store(table[j].sent_us.load(std::memory_order_relaxed),
+                                  std::memory_order_relaxed);
+        do {
+            table[hole].word.store(w, std::memory_order_release);
+        } while (!table[j].word.compare_exchange_weak(w, kUsed, std::memory_order_acq_rel));
+        hole = j;
+    }
+    table[hole].word.store(0, std::memory_order_release);
+}
+
+// --- Поток приёма ---
+bool InflightTable::mark_answered(uint32_t ip, uint16_t port, uint8_t& attempt, uint64_t& sent_us) {
+    uint64_t key = make_key(ip, port);
+    size_t i = find(key);
+    if (i == SIZE_MAX) return false;
+    uint64_t w = table[i].word.load(std::memory_order_acquire);
+    while (key_of(w) == key && !(w & kAnswered)) {
+        uint64_t seen_sent = table[i].sent_us.load(std::memory_order_relaxed);
+        if (table[i].word.compare_exchange_weak(w, w | kAnswered, std::memory_order_acq_rel)) {
+            attempt = attempt_of(w);
+            sent_us = seen_sent;
+            return true;
+        }
+    }
+    return false;
+}
+#endif
@@ -1,51 +1,286 @@
 #include "json_writer.hpp"
-#include <fstream>
-#include <sstream>
+#include <charconv>
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define JSON_WRITER_X86 1
+#endif
 
 namespace JsonWriter {
 
-    std::string escape(const std::string& str) {
-        std::ostringstream oss;
-        for (char c : str) {
-            switch (c) {
-                case '"': oss << "\\\""; break;
-                case '\\': oss << "\\\\"; break;
-                case '\n': oss << "\\n"; break;
-                case '\r': oss << "\\r"; break;
-                case '\t': oss << "\\t"; break;
-                default: oss << c; break;
+    // Байт требует экранирования: ", \ или < 0x20
+    static inline bool special(unsigned char c) {
+        return c == '"' || c == '\\' || c < 0x20;
+    }
+
+    // Индекс первого спецсимвола в [i, n) или n
+    static size_t find_special_scalar(const char* s, size_t i, size_t n) {
+        while (i < n && !special((unsigned char)s[i])) ++i;
+        return i;
+    }
+
+#ifdef JSON_WRITER_X86
+    // Сравнения SSE2 знаковые, поэтому «c < 0x20» считается как max(c, 0x1f) == 0x1f
+    static size_t find_special_sse2(const char* s, size_t i, size_t n) {
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i slash = _mm_set1_epi8('\\');
+        const __m128i ctl = _mm_set1_epi8(0x1f);
+        for (; i + 16 <= n; i += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(s + i));
+            __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, slash)),
+                                       _mm_cmpeq_epi8(_mm_max_epu8(v, ctl), ctl));
+            int mask = _mm_movemask_epi8(hit);
+            if (mask) return i + __builtin_ctz(mask);
+        }
+        return find_special_scalar(s, i, n);
+    }
+
+    __attribute__((target("avx2")))
+    static size_t find_special_avx2(const char* s, size_t i, size_t n) {
+        const __m256i quote = _mm256_set1_epi8('"');
+        const __m256i slash = _mm256_set1_epi8('\\');
+        const __m256i ctl = _mm256_set1_epi8(0x1f);
+        for (; i + 32 <= n; i += 32) {
+            __m256i v = _mm256_loadu_si256((const __m256i*)(s + i));
+            __m256i hit = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, slash)),
+                _mm256_cmpeq_epi8(_mm256_max_epu8(v, ctl), ctl));
+            unsigned mask = (unsigned)_mm256_movemask_epi8(hit);
+            if (mask) return i + __builtin_ctz(mask);
+        }
+        return find_special_sse2(s, i, n);
+    }
+
+    using FindFn = size_t (*)(const char*, size_t, size_t);
+    static const FindFn find_special =
+        __builtin_cpu_supports("avx2") ? find_special_avx2 : find_special_sse2;
+#else
+    static size_t find_special(const char* s, size_t i, size_t n) {
+        return find_special_scalar(s, i, n);
+    }
+#endif
+
+    static void escape_byte(std::string& out, unsigned char c) {
+        static const char hex[] = "0123456789abcdef";
+        switch (c) {
+            case '"': out.append("\\\"", 2); break;
+            case '\\': out.append("\\\\", 2); break;
+            case '\n': out.append("\\n", 2); break;
+            case '\r': out.append("\\r", 2); break;
+            case '\t': out.append("\\t", 2); break;
+            default: {
+                char u[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 15]};
+                out.append(u, 6);
+                break;
             }
         }
-        return oss.str();
     }
 
-    std::string to_json(const std::string& target, const std::vector<ScanResult>& results) {
-        std::ostringstream oss;
-        oss << "{\n";
-        oss << "  \"target\": \"" << escape(target) << "\",\n";
-        oss << "  \"results\": [\n";
+    void escape(std::string& out, const char* s, size_t n) {
+        size_t i = 0;
+        while (i < n) {
+            size_t j = find_special(s, i, n);
+            out.append(s + i, j - i);
+            if (j == n) break;
+            escape_byte(out, (unsigned char)s[j]);
+            i = j + 1;
+        }
+    }
+
+    void append_string(std::string& out, std::string_view s) {
+        out += '"';
+        escape(out, s);
+        out += '"';
+    }
+
+    void append_uint(std::string& out, uint64_t v) {
+        char buf[20];
+        auto res = std::to_chars(buf, buf + sizeof(buf), v);
+        out.append(buf, res.ptr - buf);
+    }
+
+    void append_dotted(std::string& out, uint32_t ip) {
+        char buf[15]; // 255.255.255.255
+        char* p = buf;
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            unsigned octet = (ip >> shift) & 0xff;
+            if (octet >= 100) *p++ = char('0' + octet / 100);
+            if (octet >= 10) *p++ = char('0' + octet / 10 % 10);
+            *p++ = char('0' + octet % 10);
+            if (shift) *p++ = '.';
+        }
+        out.append(buf, p - buf);
+    }
+
+    void append_ip(std::string& out, uint32_t ip) {
+        out += '"';
+        append_dotted(out, ip);
+        out += '"';
+    }
+
+    void append_ms(std::string& out, uint64_t us) {
+        append_uint(out, us / 1000);
+        char frac[4] = {'.', char('0' + us / 100 % 10), char('0' + us / 10 % 10), char('0' + us % 10)};
+        out.append(frac, 4);
+    }
+
+    // ,"service":...[,"product":...][,"version":...] — при непустом service
+    static void append_service(std::string& out, std::string_view service,
+                               std::string_view product, std::string_view version) {
+        if (service.empty()) return;
+        out.append(",\"service\":", 11);
+        append_string(out, service);
+        if (!product.empty()) {
+            out.append(",\"product\":", 11);
+            append_string(out, product);
+        }
+        if (!version.empty()) {
+            out.append(",\"version\":", 11);
+            append_string(out, version);
+        }
+    }
+
+    void append_result(std::string& out, uint32_t ip, uint16_t port, Proto proto, bool open,
+                       std::string_view banner, std::string_view service,
+                       std::string_view product, std::string_view version, uint64_t ts_ms) {
+        out.append("{\"ip\":", 6);
+        append_ip(out, ip);
+        out.append(",\"port\":", 8);
+        append_uint(out, port);
+        if (proto == Proto::UDP) out.append(",\"proto\":\"udp\"", 14);
+        if (open) {
+            out.append(",\"open\":true,\"banner\":", 22);
+        } else {
+            out.append(",\"open\":false,\"banner\":", 23);
+        }
+        append_string(out, banner);
+        append_service(out, service, product, version);
+        if (ts_ms) {
+            out.append(",\"ts\":", 6);
+            append_uint(out, ts_ms);
+        }
+        out += '}';
+    }
 
-        for (size_t i = 0; i < results.size(); ++i) {
-            const auto& r = results[i];
-            oss << "    {\n";
-            oss << "      \"port\": " << r.port << ",\n";
-            oss << "      \"open\": " << (r.open ? "true" : "false") << ",\n";
-            oss << "      \"banner\": \"" << escape(r.banner) << "\"\n";
-            oss << "    }";
-            if (i + 1 < results.size()) oss << ",";
-            oss << "\n";
+    void append_change(std::string& out, std::string_view kind, const ScanResult& r,
+                       const Baseline::Entry* was) {
+        out.append("{\"change\":", 10);
+        append_string(out, kind);
+        out.append(",\"ip\":", 6);
+        append_ip(out, r.ip);
+        out.append(",\"port\":", 8);
+        append_uint(out, (uint64_t)r.port);
+        if (r.proto == Proto::UDP) out.append(",\"proto\":\"udp\"", 14);
+        if (r.open) {
+            out.append(",\"banner\":", 10);
+            append_string(out, r.banner);
+            append_service(out, r.service.service, r.service.product, r.service.version);
+        }
+        if (was) {
+            out.append(",\"was\":{\"banner\":", 17);
+            append_string(out, was->banner);
+            append_service(out, was->service.service, was->service.product, was->service.version);
+            out += '}';
         }
+        out += '}';
+    }
 
-        oss << "  ]\n";
-        oss << "}\n";
-        return oss.str();
+    void append_host(std::string& out, uint32_t ip, uint32_t srtt_us, uint32_t rttvar_us,
+                     uint32_t timeout_ms, uint32_t samples) {
+        out.append("{\"ip\":", 6);
+        append_ip(out, ip);
+        out += ",\"srtt_ms\":";
+        append_ms(out, srtt_us);
+        out += ",\"rttvar_ms\":";
+        append_ms(out, rttvar_us);
+        out += ",\"timeout_ms\":";
+        append_uint(out, timeout_ms);
+        out += ",\"samples\":";
+        append_uint(out, samples);
+        out += '}';
     }
 
-    bool save_to_file(const std::string& filename, const std::string& json_data) {
-        std::ofstream file(filename);
-        if (!file.is_open()) return false;
-        file << json_data;
-        return true;
+    // --- Документ ---
+    static constexpr size_t kChunk = 1 << 20;
+
+    Document::Document(FILE* f) : f(f) {
+        buf.reserve(kChunk + 4096);
+    }
+
+    void Document::begin(std::string_view target) {
+        buf += "{\n  \"target\": ";
+        append_string(buf, target);
+        buf += ",\n  \"results\": [";
+        first = true;
+    }
+
+    // Элементы массива разделяются запятыми, каждый на своей строке
+    void Document::item() {
+        buf += first ? "\n    " : ",\n    ";
+        first = false;
+    }
+
+    void Document::result(uint32_t ip, uint16_t port, Proto proto, bool open,
+                          std::string_view banner, std::string_view service,
+                          std::string_view product, std::string_view version) {
+        item();
+        append_result(buf, ip, port, proto, open, banner, service, product, version);
+        spill(false);
+    }
+
+    void Document::hosts() {
+        buf += "\n  ],\n  \"hosts\": [";
+        first = true;
+    }
+
+    void Document::host(uint32_t ip, uint32_t srtt_us, uint32_t rttvar_us, uint32_t timeout_ms,
+                        uint32_t samples) {
+        item();
+        append_host(buf, ip, srtt_us, rttvar_us, timeout_ms, samples);
+        spill(false);
+    }
+
+    void Document::end() {
+        buf += "\n  ]\n}\n";
+        spill(true);
+    }
+
+    void Document::begin_diff(std::string_view target, std::string_view baseline) {
+        buf += "{\n  \"target\": ";
+        append_string(buf, target);
+        buf += ",\n  \"baseline\": ";
+        append_string(buf, baseline);
+        buf += ",\n  \"changes\": [";
+        first = true;
+    }
+
+    void Document::change(std::string_view kind, const ScanResult& r, const Baseline::Entry* was) {
+        item();
+        append_change(buf, kind, r, was);
+        spill(false);
+    }
+
+    void Document::end_diff(const DiffSummary& s) {
+        buf += "\n  ],\n  \"summary\": {\"baseline\":";
+        append_uint(buf, s.baseline);
+        buf += ",\"confirmed\":";
+        append_uint(buf, s.confirmed);
+        buf += ",\"opened\":";
+        append_uint(buf, s.opened);
+        buf += ",\"closed\":";
+        append_uint(buf, s.closed);
+        buf += ",\"changed\":";
+        append_uint(buf, s.changed);
+        buf += "}\n}\n";
+        spill(true);
+    }
+
+    void Document::spill(bool force) {
+        if (force || buf.size() >= kChunk) {
+            std::fwrite(buf.data(), 1, buf.size(), f);
+            buf.clear();
+        }
     }
 
 }
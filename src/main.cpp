@@ -1,57 +1,341 @@
 #include "scanner.hpp"
+#include "ndjson_writer.hpp"
+#include "baseline.hpp"
+#include <algorithm>
+#include <chrono>
+#include <csignal>
 #include <iostream>
+#include <sys/resource.h>
+
+// Сканер для обработчика SIGINT/SIGTERM (только с --resume)
+static Scanner* interrupt_target = nullptr;
+
+static void on_interrupt(int) {
+    if (interrupt_target) interrupt_target->stop();
+}
+
+// CPU-время процесса (user + sys) в микросекундах
+static uint64_t cpu_time_us() {
+    rusage ru{};
+    getrusage(RUSAGE_SELF, &ru);
+    return (uint64_t)(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000
+         + ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+}
 
 int main(int argc, char* argv[]) {
     if (argc < 5) {
         std::cerr << "Usage: " << argv[0]
-                  << " -t <target> -p <ports> [-m threads] [-s] [-b] [-o output.json]\n";
+                  << " -t <targets> | -iL <file> -p <ports> | -u <udp ports> [-m threads] [-s] [-b] [-o output.json] [--format json|ndjson|bin]"
+                  << " [--timeout ms] [--min-timeout ms] [--max-timeout ms] [--retries n] [--inflight n] [--syn-inflight n] [--banner-inflight n] [--banner-timeout ms] [--fingerprints file] [--rate pps] [--udp-rate pps] [--udp-retries n] [--discover] [--resume state] [--baseline previous] [--order random|frequency] [--cutoff n] [--engine epoll|uring] [--seed n] [--shard k/n]"
+                  << " [--stats]\n";
         return 1;
     }
 
     std::string target;
-    std::vector<int> ports;
-    int threads = 10;
-    bool syn_mode = false;
-    bool grab_banner = false;
-    std::string output_file = "results.json";
+    TargetSet targets;
+    std::string target_err;
+    PortSet ports;
+    PortSet udp_ports;
+    ScanOptions opts;
+    std::string output_file;
+    bool ndjson = false;
+    bool binary = false;
+    bool print_stats = false;
+    std::string fingerprint_file;
+    std::string resume_file;
+    std::string baseline_file;
 
     // --- парсинг аргументов ---
     for (int i = 1; i < argc; ++i) {
         std::string arg = argv[i];
         if (arg == "-t" && i + 1 < argc) {
-            target = argv[++i];
+            std::string spec = argv[++i];
+            if (!targets.add(spec, target_err)) {
+                std::cerr << "❌ Bad target: " << target_err << "\n";
+                return 1;
+            }
+            target += (target.empty() ? "" : ",") + spec;
+        } else if (arg == "-iL" && i + 1 < argc) {
+            std::string path = argv[++i];
+            if (!targets.add_file(path, target_err)) {
+                std::cerr << "❌ Bad target file: " << target_err << "\n";
+                return 1;
+            }
+            target += (target.empty() ? "@" : ",@") + path;
         } else if (arg == "-p" && i + 1 < argc) {
-            std::string port_arg = argv[++i];
-            size_t dash = port_arg.find('-');
-            if (dash != std::string::npos) {
-                int start = std::stoi(port_arg.substr(0, dash));
-                int end = std::stoi(port_arg.substr(dash + 1));
-                for (int p = start; p <= end; ++p) ports.push_back(p);
-            } else {
-                ports.push_back(std::stoi(port_arg));
+            std::string port_err;
+            if (!PortSet::parse(argv[++i], ports, port_err)) {
+                std::cerr << "❌ Bad ports: " << port_err << "\n";
+                return 1;
+            }
+        } else if (arg == "-u" && i + 1 < argc) {
+            std::string port_err;
+            if (!PortSet::parse(argv[++i], udp_ports, port_err)) {
+                std::cerr << "❌ Bad UDP ports: " << port_err << "\n";
+                return 1;
             }
         } else if (arg == "-m" && i + 1 < argc) {
-            threads = std::stoi(argv[++i]);
+            opts.threads = std::stoi(argv[++i]);
         } else if (arg == "-s") {
-            syn_mode = true;
+            opts.syn_mode = true;
         } else if (arg == "-b") {
-            grab_banner = true;
+            opts.grab_banner = true;
         } else if (arg == "-o" && i + 1 < argc) {
             output_file = argv[++i];
+        } else if (arg == "--timeout" && i + 1 < argc) {
+            opts.timeout_ms = std::stoi(argv[++i]);
+        } else if (arg == "--min-timeout" && i + 1 < argc) {
+            opts.min_timeout_ms = std::stoi(argv[++i]);
+        } else if (arg == "--max-timeout" && i + 1 < argc) {
+            opts.max_timeout_ms = std::stoi(argv[++i]);
+        } else if (arg == "--syn-inflight" && i + 1 < argc) {
+            opts.syn_inflight = std::stoi(argv[++i]);
+        } else if (arg == "--banner-inflight" && i + 1 < argc) {
+            opts.banner_inflight = std::stoi(argv[++i]);
+        } else if (arg == "--banner-timeout" && i + 1 < argc) {
+            opts.banner_timeout_ms = std::stoi(argv[++i]);
+        } else if (arg == "--fingerprints" && i + 1 < argc) {
+            fingerprint_file = argv[++i];
+        } else if (arg == "--rate" && i + 1 < argc) {
+            opts.rate = std::stoi(argv[++i]);
+        } else if (arg == "--udp-rate" && i + 1 < argc) {
+            opts.udp_rate = std::stoi(argv[++i]);
+        } else if (arg == "--udp-retries" && i + 1 < argc) {
+            opts.udp_retries = std::stoi(argv[++i]);
+        } else if (arg == "--resume" && i + 1 < argc) {
+            resume_file = argv[++i];
+        } else if (arg == "--baseline" && i + 1 < argc) {
+            baseline_file = argv[++i];
+        } else if (arg == "--order" && i + 1 < argc) {
+            std::string order = argv[++i];
+            opts.by_frequency = order == "frequency";
+            if (!opts.by_frequency && order != "random") {
+                std::cerr << "❌ Unknown order: " << order << "\n";
+                return 1;
+            }
+        } else if (arg == "--cutoff" && i + 1 < argc) {
+            opts.cutoff = std::stoi(argv[++i]);
+            if (opts.cutoff <= 0) {
+                std::cerr << "❌ --cutoff needs a positive number of ports\n";
+                return 1;
+            }
+            // Отсечка имеет смысл только по самым частым портам
+            opts.by_frequency = true;
+        } else if (arg == "--discover") {
+            opts.discover = true;
+        } else if (arg == "--retries" && i + 1 < argc) {
+            opts.retries = std::stoi(argv[++i]);
+        } else if (arg == "--inflight" && i + 1 < argc) {
+            opts.max_inflight = std::stoi(argv[++i]);
+        } else if (arg == "--seed" && i + 1 < argc) {
+            opts.seed = std::stoull(argv[++i]);
+        } else if (arg == "--shard" && i + 1 < argc) {
+            std::string shard = argv[++i];
+            size_t slash = shard.find('/');
+            if (slash != std::string::npos) {
+                opts.shard_index = std::stoull(shard.substr(0, slash));
+                opts.shard_count = std::stoull(shard.substr(slash + 1));
+            }
+            if (slash == std::string::npos || opts.shard_count == 0 ||
+                opts.shard_index >= opts.shard_count) {
+                std::cerr << "❌ Bad shard, expected k/n with k < n: " << shard << "\n";
+                return 1;
+            }
+        } else if (arg == "--format" && i + 1 < argc) {
+            std::string format = argv[++i];
+            ndjson = format == "ndjson";
+            binary = format == "bin";
+            if (!ndjson && !binary && format != "json") {
+                std::cerr << "❌ Unknown format: " << format << "\n";
+                return 1;
+            }
+        } else if (arg == "--stats") {
+            print_stats = true;
+        } else if (arg == "--engine" && i + 1 < argc) {
+            std::string engine = argv[++i];
+            if (engine == "uring") {
+                opts.backend = ConnectBackend::URING;
+            } else if (engine != "epoll") {
+                std::cerr << "❌ Unknown engine: " << engine << "\n";
+                return 1;
+            }
         }
     }
 
-    if (target.empty() || ports.empty()) {
-        std::cerr << "❌ Target (-t) and ports (-p) are required.\n";
+    if (targets.empty() || (ports.empty() && udp_ports.empty())) {
+        std::cerr << "❌ Target (-t) and ports (-p and/or -u) are required.\n";
+        return 1;
+    }
+
+    // Шарды делят одну перестановку, поэтому ключ у всех запусков должен совпадать
+    if (opts.shard_count > 1 && opts.seed == 0) {
+        std::cerr << "❌ --shard requires the same --seed on every shard\n";
+        return 1;
+    }
+
+    // Живые хосты каждый шард находит сам — при разных ответах нумерация проб разойдётся
+    if (opts.discover && opts.shard_count > 1) {
+        std::cerr << "[!] --discover with --shard: shards may see different live hosts,"
+                     " so their probe sets can overlap or leave gaps\n";
+    }
+
+    // Второй проход --cutoff зависит от находок первого, как --discover — от ответов
+    if (opts.cutoff > 0 && opts.shard_count > 1) {
+        std::cerr << "[!] --cutoff with --shard: each shard decides from its own part of the"
+                     " top ports, so a host may be cut in one shard and scanned in another\n";
+    }
+    if (opts.cutoff > 0 && !resume_file.empty()) {
+        std::cerr << "❌ --resume cannot be combined with --cutoff: the second pass depends on the first\n";
         return 1;
     }
 
+    // Находки прошлых запусков живут только в дописываемом NDJSON
+    if (!resume_file.empty() && !ndjson) {
+        std::cerr << "❌ --resume needs --format ndjson: earlier results are kept in the appended log\n";
+        return 1;
+    }
+    if (!resume_file.empty() && opts.discover) {
+        std::cerr << "❌ --resume cannot be combined with --discover: live hosts may differ between runs\n";
+        return 1;
+    }
+
+    if (!baseline_file.empty() && opts.cutoff > 0) {
+        std::cerr << "❌ --baseline cannot be combined with --cutoff: a cut host would read as all ports closed\n";
+        return 1;
+    }
+
+    // Отчёт --baseline — один JSON с отличиями, его не из чего собрать по ходу скана
+    if (!baseline_file.empty() && (ndjson || binary)) {
+        std::cerr << "❌ --baseline writes a JSON diff and cannot be combined with --format ndjson or bin\n";
+        return 1;
+    }
+
+    if (output_file.empty()) {
+        output_file = ndjson ? "results.ndjson" : binary ? "results.scnr"
+                    : !baseline_file.empty() ? "diff.json" : "results.json";
+    }
+
+    Baseline baseline;
+    uint64_t baseline_ms = 0;
+    if (!baseline_file.empty()) {
+        auto b0 = std::chrono::steady_clock::now();
+        std::string baseline_err;
+        if (!baseline.load(baseline_file, baseline_err)) {
+            std::cerr << "❌ Bad baseline: " << baseline_err << "\n";
+            return 1;
+        }
+        baseline_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                          std::chrono::steady_clock::now() - b0).count();
+    }
+
+    // Сигнатуры сервисов для баннеров и UDP-ответов: встроенные или из --fingerprints
+    Fingerprints fingerprints;
+    bool identify = opts.grab_banner || !udp_ports.empty();
+    if (identify) {
+        std::string fp_err;
+        bool loaded = fingerprint_file.empty() ? fingerprints.load_builtin(fp_err)
+                                               : fingerprints.load_file(fingerprint_file, fp_err);
+        if (!loaded) {
+            std::cerr << "❌ Bad fingerprints: " << fp_err << "\n";
+            return 1;
+        }
+    }
+
     // --- запуск сканера ---
-    Scanner scanner(target, ports, threads, syn_mode, grab_banner);
-    auto results = scanner.run();
+    Scanner scanner(target, targets, ports, udp_ports, opts);
+    if (identify) scanner.fingerprint_with(fingerprints);
+    if (!baseline_file.empty()) scanner.diff_against(baseline);
+    NdjsonWriter stream;
+    if (ndjson) {
+        if (!stream.open(output_file)) return 1;
+        scanner.stream_to(stream);
+    }
+    if (!resume_file.empty()) {
+        std::string resume_err;
+        if (!scanner.resume_from(resume_file, resume_err)) {
+            std::cerr << "❌ Bad resume state: " << resume_err << "\n";
+            return 1;
+        }
+        if (scanner.stats().resumed > 0) {
+            std::cout << "[+] Resuming: " << scanner.stats().resumed << " of "
+                      << scanner.probe_count() << " probes already done\n";
+        }
+        // Первый сигнал — дать начатым пробам доработать и сохранить состояние, второй — выход сразу
+        interrupt_target = &scanner;
+        struct sigaction sa{};
+        sa.sa_handler = on_interrupt;
+        sa.sa_flags = SA_RESETHAND;
+        sigaction(SIGINT, &sa, nullptr);
+        sigaction(SIGTERM, &sa, nullptr);
+    }
+    auto t0 = std::chrono::steady_clock::now();
+    uint64_t cpu0 = cpu_time_us();
+    uint64_t open_ports = scanner.run();
+    interrupt_target = nullptr;
+    uint64_t cpu_us = cpu_time_us() - cpu0;
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    bool written = ndjson ? stream.close() : true;
+    uint64_t found = ndjson ? stream.records() : open_ports;
+
+    if (print_stats) {
+        uint64_t probes = scanner.probe_count() - scanner.stats().resumed;
+        std::cout << "[+] " << probes << " probes in " << (int)(secs * 1000) << " ms ("
+                  << (int)(probes / std::max(secs, 1e-6)) << " probes/s, "
+                  << (double)cpu_us / std::max<uint64_t>(probes, 1) << " us CPU/probe), open="
+                  << found << "\n";
+        const auto& st = scanner.stats();
+        if (st.discovered) {
+            std::cout << "[+] Discovery: " << st.hosts_alive << "/" << st.hosts_total
+                      << " hosts up in " << st.discover_ms << " ms (arp=" << st.alive_arp
+                      << " icmp=" << st.alive_icmp << " tcp=" << st.alive_tcp << ")\n";
+        }
+        if (!baseline_file.empty()) {
+            std::cout << "[+] Baseline: " << baseline.size() << " open ports loaded in " << baseline_ms
+                      << " ms, " << st.baseline_probes << " re-probed first\n";
+        }
+        if (opts.cutoff > 0) {
+            std::cout << "[+] Cutoff: " << st.cutoff_hosts << " hosts with no open port in the top "
+                      << opts.cutoff << " skipped, " << st.cutoff_skipped << " probes saved\n";
+        }
+        if (st.filter_counting) {
+            std::cout << "[+] BPF filter dropped " << st.filtered << " packets in kernel, ring drops="
+                      << st.kernel_drops << "\n";
+        }
+        if (st.paced) {
+            std::cout << "[+] Rate: target=" << (uint64_t)st.rate.max_pps << " pps, final="
+                      << (uint64_t)st.rate.final_pps << ", lowest=" << (uint64_t)st.rate.min_pps
+                      << ", AIMD cuts=" << st.rate.decreases << "\n";
+        }
+        if (!udp_ports.empty()) {
+            std::cout << "[+] UDP: closed=" << st.udp_closed << " filtered=" << st.udp_filtered
+                      << " no reply=" << st.udp_silent << "\n";
+        }
+    }
 
-    // --- JSON вывод ---
-    scanner.save_json(output_file);
+    // --- JSON вывод (NDJSON уже записан по ходу скана) ---
+    DiffSummary diff;
+    if (!baseline_file.empty()) {
+        written = scanner.save_diff(output_file, baseline_file, diff);
+    } else if (binary) {
+        written = scanner.save_binary(output_file);
+    } else if (!ndjson) {
+        scanner.save_json(output_file);
+    }
+    if (!written) {
+        std::cerr << "❌ Results in " << output_file << " are incomplete\n";
+        return 1;
+    }
+    if (scanner.interrupted()) {
+        std::cout << "[!] Scan interrupted. Results so far are in " << output_file
+                  << "; run the same command again to continue from " << resume_file << "\n";
+        return 130;
+    }
+    if (!baseline_file.empty()) {
+        std::cout << "✅ Scan complete: " << diff.confirmed << "/" << diff.baseline << " confirmed, +"
+                  << diff.opened << " opened, -" << diff.closed << " closed, " << diff.changed
+                  << " changed. Diff saved to " << output_file << "\n";
+        return 0;
+    }
     std::cout << "✅ Scan complete. Results saved to " << output_file << "\n";
 
     return 0;
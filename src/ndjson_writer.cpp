@@ -0,0 +1,130 @@
+#include "ndjson_writer.hpp"
+#include "json_writer.hpp"
+#include "utils.hpp"
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+
+NdjsonWriter::~NdjsonWriter() {
+    close();
+}
+
+bool NdjsonWriter::open(const std::string& path) {
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        std::cerr << "[-] " << path << ": " << std::strerror(errno) << "\n";
+        return false;
+    }
+    buffer.reserve(kBufferBytes + 4096);
+    thread = std::thread(&NdjsonWriter::loop, this);
+    return true;
+}
+
+void NdjsonWriter::push(const ScanResult& r) {
+    std::unique_lock<std::mutex> lock(mtx);
+    space.wait(lock, [this] { return queue.size() < kQueueLimit; });
+    queue.push_back(r);
+    if (queue.size() == 1) ready.notify_one();
+}
+
+void NdjsonWriter::sync() {
+    std::unique_lock<std::mutex> lock(mtx);
+    if (fd < 0) return;
+    uint64_t ticket = ++sync_wanted;
+    ready.notify_one();
+    synced.wait(lock, [this, ticket] { return sync_done >= ticket || closing; });
+}
+
+bool NdjsonWriter::close() {
+    if (fd < 0) return !failed;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        closing = true;
+    }
+    ready.notify_one();
+    thread.join();
+    ::close(fd);
+    fd = -1;
+    return !failed;
+}
+
+// --- Поток записи ---
+void NdjsonWriter::loop() {
+    using clock = std::chrono::steady_clock;
+    auto last_flush = clock::now();
+    auto last_sync = last_flush;
+    bool unsynced = false;
+    std::vector<ScanResult> batch;
+
+    while (true) {
+        bool done;
+        // Запрошенный sync покрывает записи, взятые в этот же batch
+        uint64_t sync_ticket;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            ready.wait_for(lock, std::chrono::milliseconds(kFlushMs), [this] {
+                return !queue.empty() || closing || sync_wanted > sync_done;
+            });
+            batch.swap(queue);
+            done = closing && batch.empty();
+            sync_ticket = sync_wanted;
+        }
+        space.notify_all();
+
+        for (const auto& r : batch) {
+            append(r);
+            if (buffer.size() >= kBufferBytes) flush();
+        }
+        written += batch.size();
+        batch.clear();
+
+        auto now = clock::now();
+        bool forced = sync_ticket > sync_done;
+        if (!buffer.empty() &&
+            (done || forced || now - last_flush >= std::chrono::milliseconds(kFlushMs))) {
+            flush();
+            last_flush = now;
+            unsynced = true;
+        }
+        if (unsynced &&
+            (done || forced || now - last_sync >= std::chrono::milliseconds(kFsyncMs))) {
+            if (fsync(fd) != 0 && !failed) {
+                std::cerr << "[-] fsync: " << std::strerror(errno) << "\n";
+                failed = true;
+            }
+            last_sync = now;
+            unsynced = false;
+        }
+        if (forced) {
+            std::lock_guard<std::mutex> lock(mtx);
+            sync_done = sync_ticket;
+            synced.notify_all();
+        }
+        if (done) return;
+    }
+}
+
+void NdjsonWriter::append(const ScanResult& r) {
+    JsonWriter::append_result(buffer, r, now_epoch_ms());
+    buffer += '\n';
+}
+
+// Буфер содержит только целые строки, так что читатель файла (tail -f)
+// никогда не увидит оборванную запись, кроме как при ошибке посреди write
+void NdjsonWriter::flush() {
+    size_t off = 0;
+    while (off < buffer.size() && !failed) {
+        ssize_t n = ::write(fd, buffer.data() + off, buffer.size() - off);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "[-] NDJSON write: " << std::strerror(errno) << "\n";
+            failed = true;
+            break;
+        }
+        off += (size_t)n;
+    }
+    buffer.clear();
+}
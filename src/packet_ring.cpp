@@ -0,0 +1,107 @@
+#include "packet_ring.hpp"
+
+#ifdef __linux__
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <arpa/inet.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <poll.h>
+#include <unistd.h>
+
+// 32 блока по 1 МБ: ~20 тыс. коротких ответов на блок, запас на всплески
+static const unsigned kBlockSize = 1 << 20;
+static const unsigned kBlockCount = 32;
+static const unsigned kFrameSize = 2048;
+// Ядро отдаёт недозаполненный блок через столько миллисекунд
+static const unsigned kBlockTimeoutMs = 10;
+
+#ifndef PACKET_IGNORE_OUTGOING
+#define PACKET_IGNORE_OUTGOING 23
+#endif
+
+PacketRing::~PacketRing() {
+    if (map) munmap(map, map_len);
+    if (sock >= 0) close(sock);
+}
+
+bool PacketRing::open(int ifindex) {
+    // SOCK_DGRAM: ядро снимает L2-заголовок, tp_net сразу указывает на IP
+    sock = socket(AF_PACKET, SOCK_DGRAM, htons(ETH_P_IP));
+    if (sock < 0) return false;
+
+    int version = TPACKET_V3;
+    if (setsockopt(sock, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0) return false;
+
+    // Свои же SYN в кольцо не нужны (Linux 4.20+; на старых ядрах их отсекает
+    // проверка sll_pkttype ниже)
+    int one = 1;
+    setsockopt(sock, SOL_PACKET, PACKET_IGNORE_OUTGOING, &one, sizeof(one));
+
+    tpacket_req3 req{};
+    req.tp_block_size = kBlockSize;
+    req.tp_block_nr = kBlockCount;
+    req.tp_frame_size = kFrameSize;
+    req.tp_frame_nr = kBlockSize / kFrameSize * kBlockCount;
+    req.tp_retire_blk_tov = kBlockTimeoutMs;
+    if (setsockopt(sock, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0) return false;
+
+    map_len = (size_t)kBlockSize * kBlockCount;
+    void* m = mmap(nullptr, map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED, sock, 0);
+    if (m == MAP_FAILED) {
+        // MAP_LOCKED упирается в RLIMIT_MEMLOCK — без него тоже работает
+        m = mmap(nullptr, map_len, PROT_READ | PROT_WRITE, MAP_SHARED, sock, 0);
+        if (m == MAP_FAILED) return false;
+    }
+    map = (uint8_t*)m;
+    block_size = kBlockSize;
+    block_count = kBlockCount;
+
+    sockaddr_ll addr{};
+    addr.sll_family = AF_PACKET;
+    addr.sll_protocol = htons(ETH_P_IP);
+    addr.sll_ifindex = ifindex;
+    if (bind(sock, (sockaddr*)&addr, sizeof(addr)) < 0) return false;
+    return true;
+}
+
+// --- Разбор готовых блоков ---
+void PacketRing::poll(int timeout_ms, const FrameFn& fn) {
+    auto block = [this](unsigned i) {
+        return (tpacket_block_desc*)(map + (size_t)i * block_size);
+    };
+    auto ready = [](tpacket_block_desc* b) {
+        return (__atomic_load_n(&b->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER) != 0;
+    };
+
+    if (!ready(block(current))) {
+        pollfd p{sock, POLLIN | POLLERR, 0};
+        ::poll(&p, 1, timeout_ms);
+    }
+
+    // Блоки отдаются строго по кругу, так что идём от current, пока они готовы
+    for (tpacket_block_desc* b = block(current); ready(b); b = block(current)) {
+        auto* h = (tpacket3_hdr*)((uint8_t*)b + b->hdr.bh1.offset_to_first_pkt);
+        for (uint32_t i = 0; i < b->hdr.bh1.num_pkts; ++i) {
+            auto* sll = (sockaddr_ll*)((uint8_t*)h + TPACKET_ALIGN(sizeof(tpacket3_hdr)));
+            if (sll->sll_pkttype != PACKET_OUTGOING) {
+                fn((uint8_t*)h + h->tp_net, h->tp_snaplen - (h->tp_net - h->tp_mac));
+            }
+            h = (tpacket3_hdr*)((uint8_t*)h + h->tp_next_offset);
+        }
+        __atomic_store_n(&b->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+        current = (current + 1) % block_count;
+    }
+}
+
+PacketRing::Stats PacketRing::stats() {
+    tpacket_stats_v3 st{};
+    socklen_t len = sizeof(st);
+    if (sock >= 0 && getsockopt(sock, SOL_PACKET, PACKET_STATISTICS, &st, &len) == 0) {
+        total.packets += st.tp_packets;
+        total.drops += st.tp_drops;
+        total.freezes += st.tp_freeze_q_cnt;
+    }
+    return total;
+}
+#endif
@@ -0,0 +1,108 @@
+#include "packet_template.hpp"
+
+#ifdef __linux__
+#include <netinet/ip.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <cstring>
+
+struct pseudo_header {
+    uint32_t src;
+    uint32_t dst;
+    uint8_t zero;
+    uint8_t proto;
+    uint16_t len;
+};
+
+// Сумма 16-битных слов в порядке памяти (без свёртки)
+static uint32_t sum_words(const void* data, size_t nbytes) {
+    const uint8_t* p = (const uint8_t*)data;
+    uint32_t sum = 0;
+    while (nbytes > 1) {
+        uint16_t w;
+        memcpy(&w, p, 2);
+        sum += w;
+        p += 2;
+        nbytes -= 2;
+    }
+    if (nbytes == 1) {
+        uint16_t odd = 0;
+        *(uint8_t*)(&odd) = *p;
+        sum += odd;
+    }
+    return sum;
+}
+
+static uint16_t fold(uint32_t sum) {
+    sum = (sum >> 16) + (sum & 0xffff);
+    sum += (sum >> 16);
+    return (uint16_t)sum;
+}
+
+static uint16_t csum(const void* data, size_t nbytes) {
+    return (uint16_t)~fold(sum_words(data, nbytes));
+}
+
+// --- Эталонная сборка (полный пересчёт чексумм) ---
+void build_syn_packet(uint8_t* out, uint32_t src, uint32_t dst,
+                      uint16_t sport, uint16_t dport, uint32_t seq, uint8_t flags) {
+    std::memset(out, 0, kSynPacketLen);
+    auto* iph = (iphdr*)out;
+    auto* tcph = (tcphdr*)(out + sizeof(iphdr));
+
+    iph->ihl = 5;
+    iph->version = 4;
+    iph->tot_len = htons(kSynPacketLen);
+    iph->ttl = 64;
+    iph->protocol = IPPROTO_TCP;
+    iph->saddr = htonl(src);
+    iph->daddr = htonl(dst);
+    iph->check = csum(iph, sizeof(iphdr));
+
+    tcph->source = htons(sport);
+    tcph->dest = htons(dport);
+    tcph->seq = htonl(seq);
+    tcph->doff = sizeof(tcphdr) / 4;
+    tcph->th_flags = flags;
+    tcph->window = htons(65535);
+
+    pseudo_header psh{};
+    psh.src = iph->saddr;
+    psh.dst = iph->daddr;
+    psh.proto = IPPROTO_TCP;
+    psh.len = htons(sizeof(tcphdr));
+
+    uint8_t pseudo[sizeof(psh) + sizeof(tcphdr)];
+    memcpy(pseudo, &psh, sizeof(psh));
+    memcpy(pseudo + sizeof(psh), tcph, sizeof(tcphdr));
+    tcph->check = csum(pseudo, sizeof(pseudo));
+}
+
+// --- Шаблон ---
+SynTemplate::SynTemplate(uint32_t src_ip, uint8_t flags) {
+    // Изменяемые поля нулевые — их вклад в сумму добавляется в build()
+    build_syn_packet(base, src_ip, 0, 0, 0, 0, flags);
+    ip_check = ((iphdr*)base)->check;
+    tcp_check = ((tcphdr*)(base + sizeof(iphdr)))->check;
+}
+
+// RFC 1624, ф. 3: HC' = ~(~HC + ~m + m'). Старые значения полей m = 0,
+// а ~0 = -0 в обратном коде, поэтому остаётся прибавить только новые слова.
+void SynTemplate::build(uint8_t* out, uint32_t dst, uint16_t sport,
+                        uint16_t dport, uint32_t seq) const {
+    memcpy(out, base, kSynPacketLen);
+    auto* iph = (iphdr*)out;
+    auto* tcph = (tcphdr*)(out + sizeof(iphdr));
+
+    iph->daddr = htonl(dst);
+    tcph->source = htons(sport);
+    tcph->dest = htons(dport);
+    tcph->seq = htonl(seq);
+
+    uint32_t daddr_sum = sum_words(&iph->daddr, 4);
+    iph->check = (uint16_t)~fold((uint16_t)~ip_check + daddr_sum);
+
+    uint32_t tcp_sum = daddr_sum + sum_words(&tcph->source, 4) + sum_words(&tcph->seq, 4);
+    tcph->check = (uint16_t)~fold((uint16_t)~tcp_check + tcp_sum);
+}
+#endif
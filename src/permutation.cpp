@@ -0,0 +1,59 @@
+#include "permutation.hpp"
+
+// splitmix64 — дешёвое хорошее перемешивание для раундовой функции
+static uint64_t mix64(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+Permutation::Permutation(uint64_t n, uint64_t seed) : n(n) {
+    unsigned bits = 2;
+    while (bits < 64 && (1ULL << bits) < n) bits += 2;
+    half_bits = bits / 2;
+    half_mask = (1ULL << half_bits) - 1;
+    for (auto& k : keys) k = seed = mix64(seed);
+}
+
+uint64_t Permutation::encrypt(uint64_t x) const {
+    uint64_t l = x >> half_bits;
+    uint64_t r = x & half_mask;
+    for (uint64_t k : keys) {
+        uint64_t t = l ^ (mix64(r ^ k) & half_mask);
+        l = r;
+        r = t;
+    }
+    return (l << half_bits) | r;
+}
+
+// Раунды в обратном порядке: (l, r) <- (r ^ F(l), l)
+uint64_t Permutation::decrypt(uint64_t x) const {
+    uint64_t l = x >> half_bits;
+    uint64_t r = x & half_mask;
+    for (int i = 3; i >= 0; i--) {
+        uint64_t t = r ^ (mix64(l ^ keys[i]) & half_mask);
+        r = l;
+        l = t;
+    }
+    return (l << half_bits) | r;
+}
+
+// Каждый шаг — биекция домена, поэтому цикл из index рано или поздно
+// возвращается в [0, n), и разные index попадают в разные значения
+uint64_t Permutation::at(uint64_t index) const {
+    uint64_t x = index;
+    do {
+        x = encrypt(x);
+    } while (x >= n);
+    return x;
+}
+
+// Цикл в обратную сторону: первый выход в [0, n) — тот index, из которого пришли
+uint64_t Permutation::index_of(uint64_t value) const {
+    uint64_t x = value;
+    do {
+        x = decrypt(x);
+    } while (x >= n);
+    return x;
+}
@@ -0,0 +1,281 @@
+#include "ports.hpp"
+
+// Самые частые TCP-порты по nmap-services (то же, что nmap --top-ports 100/1000)
+static const char kTop100[] =
+    "7,9,13,21-23,25-26,37,53,79-81,88,106,110-111,113,119,135,139,143-144,179,199,389,427,"
+    "443-445,465,513-515,543-544,548,554,587,631,646,873,990,993,995,1025-1029,1110,1433,"
+    "1720,1723,1755,1900,2000-2001,2049,2121,2717,3000,3128,3306,3389,3986,4899,5000,5009,"
+    "5051,5060,5101,5190,5357,5432,5631,5666,5800,5900,6000-6001,6646,7070,8000,8008-8009,"
+    "8080-8081,8443,8888,9100,9999-10000,32768,49152-49157";
+
+static const char kTop1000[] =
+    "1,3-4,6-7,9,13,17,19-26,30,32-33,37,42-43,49,53,70,79-85,88-90,99-100,106,109-111,113,"
+    "119,125,135,139,143-144,146,161,163,179,199,211-212,222,254-256,259,264,280,301,306,"
+    "311,340,366,389,406-407,416-417,425,427,443-445,458,464-465,481,497,500,512-515,524,"
+    "541,543-545,548,554-555,563,587,593,616-617,625,631,636,646,648,666-668,683,687,691,"
+    "700,705,711,714,720,722,726,749,765,777,783,787,800-801,808,843,873,880,888,898,"
+    "900-903,911-912,981,987,990,992-993,995,999-1002,1007,1009-1011,1021-1100,1102,"
+    "1104-1108,1110-1114,1117,1119,1121-1124,1126,1130-1132,1137-1138,1141,1145,1147-1149,"
+    "1151-1152,1154,1163-1166,1169,1174-1175,1183,1185-1187,1192,1198-1199,1201,1213,"
+    "1216-1218,1233-1234,1236,1244,1247-1248,1259,1271-1272,1277,1287,1296,1300-1301,"
+    "1309-1311,1322,1328,1334,1352,1417,1433-1434,1443,1455,1461,1494,1500-1501,1503,1521,"
+    "1524,1533,1556,1580,1583,1594,1600,1641,1658,1666,1687-1688,1700,1717-1721,1723,1755,"
+    "1761,1782-1783,1801,1805,1812,1839-1840,1862-1864,1875,1900,1914,1935,1947,1971-1972,"
+    "1974,1984,1998-2010,2013,2020-2022,2030,2033-2035,2038,2040-2043,2045-2049,2065,2068,"
+    "2099-2100,2103,2105-2107,2111,2119,2121,2126,2135,2144,2160-2161,2170,2179,2190-2191,"
+    "2196,2200,2222,2251,2260,2288,2301,2323,2366,2381-2383,2393-2394,2399,2401,2492,2500,"
+    "2522,2525,2557,2601-2602,2604-2605,2607-2608,2638,2701-2702,2710,2717-2718,2725,2800,"
+    "2809,2811,2869,2875,2909-2910,2920,2967-2968,2998,3000-3001,3003,3005-3007,3011,3013,"
+    "3017,3030-3031,3052,3071,3077,3128,3168,3211,3221,3260-3261,3268-3269,3283,3300-3301,"
+    "3306,3322-3325,3333,3351,3367,3369-3372,3389-3390,3404,3476,3493,3517,3527,3546,3551,"
+    "3580,3659,3689-3690,3703,3737,3766,3784,3800-3801,3809,3814,3826-3828,3851,3869,3871,"
+    "3878,3880,3889,3905,3914,3918,3920,3945,3971,3986,3995,3998,4000-4006,4045,4111,"
+    "4125-4126,4129,4224,4242,4279,4321,4343,4443-4446,4449,4550,4567,4662,4848,4899-4900,"
+    "4998,5000-5004,5009,5030,5033,5050-5051,5054,5060-5061,5080,5087,5100-5102,5120,5190,"
+    "5200,5214,5221-5222,5225-5226,5269,5280,5298,5357,5405,5414,5431-5432,5440,5500,5510,"
+    "5544,5550,5555,5560,5566,5631,5633,5666,5678-5679,5718,5730,5800-5802,5810-5811,5815,"
+    "5822,5825,5850,5859,5862,5877,5900-5904,5906-5907,5910-5911,5915,5922,5925,5950,5952,"
+    "5959-5963,5987-5989,5998-6007,6009,6025,6059,6100-6101,6106,6112,6123,6129,6156,6346,"
+    "6389,6502,6510,6543,6547,6565-6567,6580,6646,6666-6669,6689,6692,6699,6779,6788-6789,"
+    "6792,6839,6881,6901,6969,7000-7002,7004,7007,7019,7025,7070,7100,7103,7106,7200-7201,"
+    "7402,7435,7443,7496,7512,7625,7627,7676,7741,7777-7778,7800,7911,7920-7921,7937-7938,"
+    "7999-8002,8007-8011,8021-8022,8031,8042,8045,8080-8090,8093,8099-8100,8180-8181,"
+    "8192-8194,8200,8222,8254,8290-8292,8300,8333,8383,8400,8402,8443,8500,8600,8649,"
+    "8651-8652,8654,8701,8800,8873,8888,8899,8994,9000-9003,9009-9011,9040,9050,9071,"
+    "9080-9081,9090-9091,9099-9103,9110-9111,9200,9207,9220,9290,9415,9418,9485,9500,"
+    "9502-9503,9535,9575,9593-9595,9618,9666,9876-9878,9898,9900,9917,9929,9943-9944,9968,"
+    "9998-10004,10009-10010,10012,10024-10025,10082,10180,10215,10243,10566,10616-10617,"
+    "10621,10626,10628-10629,10778,11110-11111,11967,12000,12174,12265,12345,13456,13722,"
+    "13782-13783,14000,14238,14441-14442,15000,15002-15004,15660,15742,16000-16001,16012,"
+    "16016,16018,16080,16113,16992-16993,17877,17988,18040,18101,18988,19101,19283,19315,"
+    "19350,19780,19801,19842,20000,20005,20031,20221-20222,20828,21571,22939,23502,24444,"
+    "24800,25734-25735,26214,27000,27352-27353,27355-27356,27715,28201,30000,30718,30951,"
+    "31038,31337,32768-32785,33354,33899,34571-34573,35500,38292,40193,40911,41511,42510,"
+    "44176,44442-44443,44501,45100,48080,49152-49161,49163,49165,49167,49175-49176,49400,"
+    "49999-50003,50006,50300,50389,50500,50636,50800,51103,51493,52673,52822,52848,52869,"
+    "54045,54328,55055-55056,55555,55600,56737-56738,57294,57797,58080,60020,60443,61532,"
+    "61900,62078,63331,64623,64680,65000,65129,65389";
+
+// Порты по убыванию доли открытых, для --order frequency. TCP: первые 100 — в
+// порядке частоты из nmap-services (тот же источник, что top100/top1000), дальше
+// службы, которые чаще всего торчат наружу сейчас: базы, кэши, поиск, брокеры,
+// API контейнеров. UDP — так же по nmap-services плюс VPN, STUN, IoT
+static const uint16_t kTcpByFrequency[] = {
+    80, 23, 443, 21, 22, 25, 3389, 110, 445, 139, 143, 53, 135, 3306, 8080, 1723, 111, 995,
+    993, 5900, 1025, 587, 8888, 199, 1720, 465, 548, 113, 81, 6001, 10000, 514, 5060, 179,
+    1026, 2000, 8443, 8000, 32768, 554, 26, 1433, 49152, 2001, 515, 8008, 49154, 1027, 5666,
+    646, 5000, 5631, 631, 49153, 8081, 2049, 88, 79, 5800, 106, 2121, 1110, 49155, 6000, 513,
+    990, 5357, 427, 49156, 543, 544, 5101, 144, 7, 389, 8009, 3128, 444, 9999, 5009, 7070,
+    5190, 3000, 5432, 1900, 3986, 13, 1029, 9, 5051, 6646, 49157, 1028, 873, 1755, 2717, 4899,
+    9100, 119, 37, 9200, 6379, 27017, 11211, 5601, 9090, 2375, 2376, 6443, 10250, 5672, 15672,
+    1883, 8883, 9092, 2181, 5984, 7001, 8161, 61616, 50000, 8088, 8181, 9000, 9443, 4443, 7443,
+    8880, 8983, 5985, 5986, 636, 3268, 1521, 2222, 8022, 4444, 5555, 7777, 8089, 8090, 9091,
+    9001, 10443, 18080, 27018, 6380, 5433, 3307, 33060, 1099, 2379, 2380, 8500, 8200, 4369,
+    25565, 3690,
+};
+static constexpr size_t kTcpNmapRanked = 100;
+
+static const uint16_t kUdpByFrequency[] = {
+    631, 161, 137, 123, 138, 1434, 445, 135, 67, 53, 139, 500, 68, 520, 1900, 4500, 514, 49152,
+    162, 69, 5353, 111, 49154, 1701, 998, 996, 997, 999, 3283, 49153, 1812, 136, 2222, 2049,
+    32768, 5060, 1025, 1433, 3456, 80, 20031, 1026, 7, 1646, 1645, 593, 518, 2048, 626, 1027,
+    11211, 1194, 51820, 3478, 5683, 47808, 10001, 27015, 19, 17, 389, 443, 5351, 623, 1604,
+    1813, 177, 2123, 2152, 6881, 5355,
+};
+
+// --- Диапазоны словами ---
+// Маска битов [lo, hi] внутри одного слова
+static uint64_t word_mask(unsigned lo, unsigned hi) {
+    uint64_t upto_hi = hi == 63 ? ~0ull : (1ull << (hi + 1)) - 1;
+    return upto_hi & ~((1ull << lo) - 1);
+}
+
+void PortSet::add_range(uint16_t lo, uint16_t hi) {
+    if (lo > hi) return;
+    size_t first = lo >> 6, last = hi >> 6;
+    if (first == last) {
+        bits[first] |= word_mask(lo & 63, hi & 63);
+        return;
+    }
+    bits[first] |= word_mask(lo & 63, 63);
+    for (size_t w = first + 1; w < last; w++) bits[w] = ~0ull;
+    bits[last] |= word_mask(0, hi & 63);
+}
+
+void PortSet::remove_range(uint16_t lo, uint16_t hi) {
+    if (lo > hi) return;
+    size_t first = lo >> 6, last = hi >> 6;
+    if (first == last) {
+        bits[first] &= ~word_mask(lo & 63, hi & 63);
+        return;
+    }
+    bits[first] &= ~word_mask(lo & 63, 63);
+    for (size_t w = first + 1; w < last; w++) bits[w] = 0;
+    bits[last] &= ~word_mask(0, hi & 63);
+}
+
+PortSet& PortSet::operator|=(const PortSet& o) {
+    for (size_t w = 0; w < kWords; w++) bits[w] |= o.bits[w];
+    return *this;
+}
+
+PortSet& PortSet::operator-=(const PortSet& o) {
+    for (size_t w = 0; w < kWords; w++) bits[w] &= ~o.bits[w];
+    return *this;
+}
+
+size_t PortSet::count() const {
+    size_t n = 0;
+    for (uint64_t w : bits) n += (size_t)__builtin_popcountll(w);
+    return n;
+}
+
+bool PortSet::empty() const {
+    for (uint64_t w : bits) {
+        if (w) return false;
+    }
+    return true;
+}
+
+std::vector<uint16_t> PortSet::to_vector() const {
+    std::vector<uint16_t> out;
+    out.reserve(count());
+    for (uint16_t port : *this) out.push_back(port);
+    return out;
+}
+
+// --- Порядок по частоте ---
+std::vector<uint16_t> PortSet::by_frequency(bool udp, std::vector<size_t>& tiers) const {
+    std::vector<uint16_t> out;
+    out.reserve(count());
+    tiers.clear();
+    PortSet placed;
+    auto close_tier = [&]() {
+        if (!out.empty() && (tiers.empty() || tiers.back() < out.size())) tiers.push_back(out.size());
+    };
+
+    const uint16_t* table = udp ? kUdpByFrequency : kTcpByFrequency;
+    size_t n = udp ? std::size(kUdpByFrequency) : std::size(kTcpByFrequency);
+    for (size_t rank = 0; rank < n; rank++) {
+        // Ярусы: десятка самых частых, сотня из nmap-services, остаток таблицы
+        if (rank == 10 || (!udp && rank == kTcpNmapRanked)) close_tier();
+        uint16_t port = table[rank];
+        if (!contains(port) || placed.contains(port)) continue;
+        placed.add(port);
+        out.push_back(port);
+    }
+    close_tier();
+
+    // Остальные TCP из top1000 вероятнее произвольных, поэтому идут своим ярусом
+    if (!udp) {
+        PortSet top;
+        std::string err;
+        parse("top1000", top, err);
+        for (uint16_t port : top) {
+            if (!contains(port) || placed.contains(port)) continue;
+            placed.add(port);
+            out.push_back(port);
+        }
+        close_tier();
+    }
+    for (uint16_t port : *this) {
+        if (!placed.contains(port)) out.push_back(port);
+    }
+    close_tier();
+    return out;
+}
+
+// --- Разбор спецификации ---
+// Номер порта 1..65535; false — не число или вне диапазона
+static bool parse_port(const std::string& s, uint16_t& port) {
+    if (s.empty() || s.size() > 5 || s.find_first_not_of("0123456789") != std::string::npos) {
+        return false;
+    }
+    unsigned long v = std::stoul(s);
+    if (v < 1 || v > 65535) return false;
+    port = (uint16_t)v;
+    return true;
+}
+
+// Один элемент списка без '!'
+static bool parse_item(const std::string& item, PortSet& out, std::string& err) {
+    if (item == "top100" || item == "top1000") {
+        return PortSet::parse(item == "top100" ? kTop100 : kTop1000, out, err);
+    }
+    size_t dash = item.find('-');
+    uint16_t lo = 1, hi = 65535;
+    bool ok;
+    if (dash == std::string::npos) {
+        ok = parse_port(item, lo);
+        hi = lo;
+    } else {
+        std::string a = item.substr(0, dash), b = item.substr(dash + 1);
+        ok = !(a.empty() && b.empty()) && (a.empty() || parse_port(a, lo)) &&
+             (b.empty() || parse_port(b, hi)) && lo <= hi;
+    }
+    if (!ok) {
+        err = "bad port or range '" + item + "'";
+        return false;
+    }
+    out.add_range(lo, hi);
+    return true;
+}
+
+bool PortSet::parse(const std::string& spec, PortSet& out, std::string& err) {
+    PortSet include, exclude;
+    bool any_include = false;
+    size_t pos = 0;
+    while (pos <= spec.size()) {
+        size_t comma = spec.find(',', pos);
+        if (comma == std::string::npos) comma = spec.size();
+        std::string item = spec.substr(pos, comma - pos);
+        pos = comma + 1;
+
+        bool negate = !item.empty() && item[0] == '!';
+        if (negate) item.erase(0, 1);
+        if (item.empty()) {
+            err = "empty item in port list '" + spec + "'";
+            return false;
+        }
+        if (!parse_item(item, negate ? exclude : include, err)) return false;
+        any_include |= !negate;
+    }
+    if (!any_include) include.add_range(1, 65535);
+    include -= exclude;
+    out |= include;
+    return true;
+}
+
+// --- Открытые порты по хостам ---
+bool HostPorts::contains(uint32_t ip, uint16_t port) const {
+    auto it = hosts.find(ip);
+    if (it == hosts.end()) return false;
+    const Host& h = it->second;
+    if (h.dense) return h.dense->contains(port);
+    return std::binary_search(h.sparse.begin(), h.sparse.end(), port);
+}
+
+bool HostPorts::insert(uint32_t ip, uint16_t port) {
+    // Находки одного хоста обычно идут подряд (а прошлый результат отсортирован)
+    if (!last || last_ip != ip) {
+        last = &hosts[ip];
+        last_ip = ip;
+    }
+    Host& h = *last;
+    if (h.dense) {
+        if (h.dense->contains(port)) return false;
+        h.dense->add(port);
+    } else {
+        auto it = std::lower_bound(h.sparse.begin(), h.sparse.end(), port);
+        if (it != h.sparse.end() && *it == port) return false;
+        h.sparse.insert(it, port);
+        // Массив дорос до размера карты — дальше карта компактнее и быстрее
+        if (h.sparse.size() >= kDenseAt) {
+            h.dense = std::make_unique<PortSet>();
+            for (uint16_t p : h.sparse) h.dense->add(p);
+            std::vector<uint16_t>().swap(h.sparse);
+        }
+    }
+    ++total;
+    return true;
+}
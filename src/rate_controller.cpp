@@ -0,0 +1,86 @@
+#include "rate_controller.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+static uint64_t mono_us() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// --- Конструктор: стартуем с целевой скорости, снижаемся по потерям ---
+RateController::RateController(double max_pps)
+    : max_pps(std::max(1.0, max_pps)), min_pps(std::max(1.0, this->max_pps / 100)),
+      pps(this->max_pps), tokens(0), refilled_us(mono_us()), window_start_us(refilled_us),
+      lowest(this->max_pps) {}
+
+void RateController::tick(uint64_t now_us) {
+    double burst = std::max(1.0, pps * kBurstMs / 1000);
+    tokens = std::min(burst, tokens + (now_us - refilled_us) * pps / 1e6);
+    refilled_us = now_us;
+
+    uint64_t age_us = now_us - window_start_us;
+    if (age_us < (uint64_t)kWindowMs * 1000) return;
+
+    // Пока держим паузу после снижения, сигналы выбрасываем
+    if (now_us < hold_until_us) {
+        answers.store(0, std::memory_order_relaxed);
+        late.store(0, std::memory_order_relaxed);
+        drops.store(0, std::memory_order_relaxed);
+        window_start_us = now_us;
+        return;
+    }
+
+    uint64_t n = answers.load(std::memory_order_relaxed);
+    uint64_t lost = drops.load(std::memory_order_relaxed);
+    // Мало ответов — копим окно дальше, но не бесконечно
+    if (lost == 0 && n < kMinSamples && age_us < (uint64_t)kMaxWindowMs * 1000) return;
+
+    uint64_t retried = late.exchange(0, std::memory_order_relaxed);
+    answers.fetch_sub(n, std::memory_order_relaxed);
+    drops.fetch_sub(lost, std::memory_order_relaxed);
+    window_start_us = now_us;
+
+    if (lost > 0 || (n >= kMinSamples && retried > kLossThreshold * n)) {
+        double loss = n > 0 ? (double)retried / n : 0;
+        double factor = std::clamp(1 - loss, kMaxDecrease, kDecrease);
+        pps = std::max(min_pps, pps * factor);
+        tokens = std::min(tokens, 0.0);
+        lowest = std::min(lowest, pps);
+        ++cuts;
+        hold_until_us = now_us + (uint64_t)kHoldMs * 1000;
+    } else if (n > 0) {
+        pps = std::min(max_pps, pps + max_pps / kIncreaseSteps);
+    }
+}
+
+size_t RateController::take(size_t want) {
+    std::lock_guard<std::mutex> lock(mtx);
+    tick(mono_us());
+    if (tokens < 1) return 0;
+    size_t n = std::min(want, (size_t)tokens);
+    tokens -= (double)n;
+    return n;
+}
+
+void RateController::charge(size_t n) {
+    std::lock_guard<std::mutex> lock(mtx);
+    tokens -= (double)n;
+}
+
+int RateController::wait_ms() {
+    std::lock_guard<std::mutex> lock(mtx);
+    tick(mono_us());
+    if (tokens >= 1) return 0;
+    return (int)std::ceil((1 - tokens) * 1000 / pps);
+}
+
+double RateController::rate() {
+    std::lock_guard<std::mutex> lock(mtx);
+    return pps;
+}
+
+RateController::Stats RateController::stats() {
+    std::lock_guard<std::mutex> lock(mtx);
+    return {max_pps, pps, lowest, cuts};
+}
@@ -0,0 +1,197 @@
+#include "result_file.hpp"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace ResultFormat;
+
+// --- Писатель ---
+ResultFileWriter::~ResultFileWriter() {
+    if (file) std::fclose(file);
+}
+
+bool ResultFileWriter::open(const std::string& path, const std::string& target_spec) {
+    file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        std::cerr << "[-] " << path << ": " << std::strerror(errno) << "\n";
+        return false;
+    }
+    std::setvbuf(file, nullptr, _IOFBF, 1 << 20);
+    // Место под заголовок; настоящий пишется в finish()
+    Header blank{};
+    std::fwrite(&blank, sizeof(blank), 1, file);
+    target = target_spec;
+    intern(target);
+    return true;
+}
+
+uint32_t ResultFileWriter::host_of(uint32_t ip) {
+    auto it = host_index.find(ip);
+    if (it != host_index.end()) return it->second;
+    uint32_t idx = (uint32_t)hosts.size();
+    hosts.push_back({ip, 0, 0, 0, 0});
+    host_index.emplace(ip, idx);
+    return idx;
+}
+
+// Смещение строки в пуле; одинаковые строки хранятся один раз
+uint32_t ResultFileWriter::intern(const std::string& s) {
+    auto it = pool_index.find(s);
+    if (it != pool_index.end()) return it->second;
+    uint32_t off = (uint32_t)pool.size();
+    pool += s;
+    pool_index.emplace(s, off);
+    return off;
+}
+
+void ResultFileWriter::add(const ScanResult& r) {
+    PortRecord rec{};
+    rec.host = host_of(r.ip);
+    rec.port = (uint16_t)r.port;
+    rec.open = r.open ? 1 : 0;
+    rec.proto = (uint8_t)r.proto;
+    if (!r.banner.empty()) {
+        rec.banner_offset = intern(r.banner);
+        rec.banner_len = (uint32_t)r.banner.size();
+    }
+    if (!r.service.service.empty()) {
+        std::string triple = r.service.service;
+        triple += '\0';
+        triple += r.service.product;
+        triple += '\0';
+        triple += r.service.version;
+        rec.service_offset = intern(triple);
+        rec.service_len = (uint32_t)triple.size();
+    }
+    std::fwrite(&rec, sizeof(rec), 1, file);
+    ++records;
+}
+
+void ResultFileWriter::add_host(const RttEstimator::HostRtt& h, int timeout_ms) {
+    auto& rec = hosts[host_of(h.ip)];
+    rec.srtt_us = h.srtt_us;
+    rec.rttvar_us = h.rttvar_us;
+    rec.timeout_ms = (uint32_t)timeout_ms;
+    rec.samples = h.samples;
+}
+
+bool ResultFileWriter::finish() {
+    if (!file) return false;
+    // Смещения в пул 32-битные
+    if (pool.size() > UINT32_MAX) {
+        std::cerr << "[-] Banner pool exceeds 4 GiB, binary results not written\n";
+        std::fclose(file);
+        file = nullptr;
+        return false;
+    }
+
+    Header head{};
+    std::memcpy(head.magic, kMagic, sizeof(kMagic));
+    head.version = kVersion;
+    head.flags = kComplete;
+    head.record_count = records;
+    head.records_offset = sizeof(Header);
+    head.host_count = hosts.size();
+    head.hosts_offset = head.records_offset + records * sizeof(PortRecord);
+    head.pool_offset = head.hosts_offset + hosts.size() * sizeof(HostRecord);
+    head.pool_size = pool.size();
+    head.target_offset = pool_index[target];
+    head.target_len = (uint32_t)target.size();
+
+    std::fwrite(hosts.data(), sizeof(HostRecord), hosts.size(), file);
+    std::fwrite(pool.data(), 1, pool.size(), file);
+    std::fseek(file, 0, SEEK_SET);
+    std::fwrite(&head, sizeof(head), 1, file);
+
+    bool ok = std::fflush(file) == 0 && !std::ferror(file);
+    if (!ok) std::cerr << "[-] Binary results: " << std::strerror(errno) << "\n";
+    ok = std::fclose(file) == 0 && ok;
+    file = nullptr;
+    return ok;
+}
+
+// --- Читатель ---
+ResultFile::~ResultFile() {
+    if (data) munmap((void*)data, size);
+}
+
+// Секция [offset, offset + count * width) целиком внутри файла
+static bool section_fits(uint64_t offset, uint64_t count, uint64_t width, size_t size) {
+    if (offset > size) return false;
+    return count <= (size - offset) / width;
+}
+
+bool ResultFile::open(const std::string& path, std::string& err) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        err = path + ": " + std::strerror(errno);
+        return false;
+    }
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(Header)) {
+        ::close(fd);
+        err = path + ": not a result file";
+        return false;
+    }
+    size = (size_t)st.st_size;
+    void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        err = path + ": mmap: " + std::strerror(errno);
+        return false;
+    }
+    data = (const uint8_t*)p;
+    madvise(p, size, MADV_SEQUENTIAL);
+
+    head = (const Header*)data;
+    if (std::memcmp(head->magic, kMagic, sizeof(kMagic)) != 0) {
+        err = path + ": not a result file";
+        return false;
+    }
+    if (head->version != kVersion) {
+        err = path + ": unsupported format version " + std::to_string(head->version);
+        return false;
+    }
+    if (!(head->flags & kComplete)) {
+        err = path + ": incomplete (scan did not finish)";
+        return false;
+    }
+    if (head->records_offset % alignof(PortRecord) || head->hosts_offset % alignof(HostRecord) ||
+        !section_fits(head->records_offset, head->record_count, sizeof(PortRecord), size) ||
+        !section_fits(head->hosts_offset, head->host_count, sizeof(HostRecord), size) ||
+        !section_fits(head->pool_offset, head->pool_size, 1, size) ||
+        (uint64_t)head->target_offset + head->target_len > head->pool_size) {
+        err = path + ": truncated or corrupt";
+        return false;
+    }
+    records = (const PortRecord*)(data + head->records_offset);
+    hosts = (const HostRecord*)(data + head->hosts_offset);
+    pool = (const char*)(data + head->pool_offset);
+
+    // Ссылки записей проверяются один раз здесь, чтобы доступ потом был без проверок
+    for (uint64_t i = 0; i < head->record_count; i++) {
+        const auto& r = records[i];
+        if (r.host >= head->host_count ||
+            (uint64_t)r.banner_offset + r.banner_len > head->pool_size ||
+            (uint64_t)r.service_offset + r.service_len > head->pool_size) {
+            err = path + ": corrupt record " + std::to_string(i);
+            return false;
+        }
+    }
+    return true;
+}
+
+// k-е поле строки service\0product\0version
+std::string_view ResultFile::service_field(const PortRecord& r, int k) const {
+    std::string_view s = string_at(r.service_offset, r.service_len);
+    for (; k > 0; k--) {
+        size_t nul = s.find('\0');
+        if (nul == std::string_view::npos) return {};
+        s.remove_prefix(nul + 1);
+    }
+    return s.substr(0, s.find('\0'));
+}
@@ -0,0 +1,139 @@
+#include "resume_state.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace ResumeFormat;
+
+ResumeState::~ResumeState() {
+    if (map) munmap((uint8_t*)map - kBitmapOffset, map_bytes);
+    if (fd >= 0) ::close(fd);
+}
+
+// --- Открытие: новый файл или сверка заголовка существующего ---
+bool ResumeState::open(const std::string& path, Header& header, std::string& err) {
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        err = path + ": " + std::strerror(errno);
+        return false;
+    }
+    words = (header.tcp_probes + header.udp_probes + 63) / 64;
+    map_bytes = kBitmapOffset + words * 8;
+
+    struct stat st{};
+    if (fstat(fd, &st) != 0) {
+        err = path + ": " + std::strerror(errno);
+        return false;
+    }
+    if (st.st_size == 0) {
+        std::memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.version = kVersion;
+        // Нули карты — дыра в файле, место на диске занимают только отмеченные страницы
+        if (pwrite(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+            ftruncate(fd, (off_t)map_bytes) != 0) {
+            err = path + ": " + std::strerror(errno);
+            return false;
+        }
+    } else {
+        Header old{};
+        if (pread(fd, &old, sizeof(old), 0) != (ssize_t)sizeof(old) ||
+            std::memcmp(old.magic, kMagic, sizeof(kMagic)) != 0) {
+            err = path + ": not a resume state file";
+            return false;
+        }
+        if (old.version != kVersion) {
+            err = path + ": unsupported state version " + std::to_string(old.version);
+            return false;
+        }
+        if (old.config != header.config || old.shard_index != header.shard_index ||
+            old.shard_count != header.shard_count || old.tcp_probes != header.tcp_probes ||
+            old.udp_probes != header.udp_probes) {
+            err = path + ": state is from a scan with other targets, ports or shard";
+            return false;
+        }
+        if ((uint64_t)st.st_size != map_bytes) {
+            err = path + ": truncated or corrupt";
+            return false;
+        }
+        header = old;
+    }
+
+    void* p = mmap(nullptr, map_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+        err = path + ": mmap: " + std::strerror(errno);
+        return false;
+    }
+    map = (uint64_t*)((uint8_t*)p + kBitmapOffset);
+
+    bits.reset(new std::atomic<uint64_t>[words]());
+    dirty.reset(new std::atomic<uint64_t>[(words / kPageWords + 64) / 64]());
+    for (uint64_t i = 0; i < words; i++) {
+        bits[i].store(map[i], std::memory_order_relaxed);
+        done_at_open += (uint64_t)__builtin_popcountll(map[i]);
+    }
+    return true;
+}
+
+// Страница помечается грязной после бита: checkpoint, сбросивший её флаг до
+// нашего OR, увидит флаг снова в следующий раз
+void ResumeState::mark(uint64_t bit) {
+    uint64_t w = bit / 64;
+    uint64_t m = 1ULL << (bit % 64);
+    if (bits[w].fetch_or(m) & m) return;
+    uint64_t page = w / kPageWords;
+    uint64_t pm = 1ULL << (page % 64);
+    if (!(dirty[page / 64].load() & pm)) dirty[page / 64].fetch_or(pm);
+}
+
+// --- Снимок -> журнал на диск -> карта в файл ---
+bool ResumeState::checkpoint(const std::function<void()>& durable) {
+    snapshot.clear();
+    snapshot_pages.clear();
+    uint64_t pages = (words + kPageWords - 1) / kPageWords;
+    for (uint64_t di = 0; di * 64 < pages; di++) {
+        uint64_t d = dirty[di].exchange(0);
+        while (d) {
+            uint64_t page = di * 64 + (uint64_t)__builtin_ctzll(d);
+            d &= d - 1;
+            snapshot_pages.push_back(page);
+            for (uint64_t w = page * kPageWords; w < std::min(words, (page + 1) * kPageWords); w++) {
+                snapshot.push_back(bits[w].load());
+            }
+        }
+    }
+    if (snapshot_pages.empty()) return true;
+
+    durable();
+
+    // Границы msync — по настоящему размеру страницы, соседние страницы одним вызовом
+    static const uintptr_t sys_page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    auto sync = [](uintptr_t from, uintptr_t to) {
+        from &= ~(sys_page - 1);
+        return msync((void*)from, to - from, MS_SYNC) == 0;
+    };
+    bool ok = true;
+    size_t k = 0;
+    uintptr_t run_from = 0, run_to = 0;
+    for (uint64_t page : snapshot_pages) {
+        uint64_t first = page * kPageWords;
+        uint64_t last = std::min(words, (page + 1) * kPageWords);
+        for (uint64_t w = first; w < last; w++) map[w] |= snapshot[k++];
+        uintptr_t from = (uintptr_t)(map + first);
+        uintptr_t to = (uintptr_t)(map + last);
+        if (run_to != 0 && from <= run_to) {
+            run_to = to;
+            continue;
+        }
+        if (run_to != 0) ok = sync(run_from, run_to) && ok;
+        run_from = from;
+        run_to = to;
+    }
+    ok = sync(run_from, run_to) && ok;
+    if (!ok) std::cerr << "[-] resume state msync: " << std::strerror(errno) << "\n";
+    return ok;
+}
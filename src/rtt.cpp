@@ -0,0 +1,51 @@
+#include "rtt.hpp"
+#include <algorithm>
+
+RttEstimator::RttEstimator(int initial_ms, int min_ms, int max_ms)
+    : min_ms(std::max(1, min_ms)) {
+    this->max_ms = std::max({this->min_ms, max_ms, initial_ms});
+    this->initial_ms = std::clamp(initial_ms, this->min_ms, this->max_ms);
+}
+
+// --- Новый замер: RFC 6298, п. 2.2–2.3 ---
+void RttEstimator::sample(uint32_t ip, uint64_t rtt_us) {
+    uint32_t r = (uint32_t)std::min<uint64_t>(rtt_us, UINT32_MAX);
+    Stripe& st = stripe(ip);
+    std::lock_guard<std::mutex> lock(st.mtx);
+    auto it = st.hosts.find(ip);
+    if (it == st.hosts.end()) {
+        st.hosts.emplace(ip, HostRtt{ip, r, r / 2, 1});
+        return;
+    }
+    HostRtt& h = it->second;
+    uint32_t delta = h.srtt_us > r ? h.srtt_us - r : r - h.srtt_us;
+    h.rttvar_us = (3 * (uint64_t)h.rttvar_us + delta) / 4;
+    h.srtt_us = (7 * (uint64_t)h.srtt_us + r) / 8;
+    ++h.samples;
+}
+
+// RTO = SRTT + 4 * RTTVAR, с округлением вверх до миллисекунды
+int RttEstimator::timeout_ms(uint32_t ip) const {
+    const Stripe& st = stripe(ip);
+    std::lock_guard<std::mutex> lock(st.mtx);
+    auto it = st.hosts.find(ip);
+    if (it == st.hosts.end()) return initial_ms;
+    uint64_t rto_us = it->second.srtt_us + 4 * (uint64_t)it->second.rttvar_us;
+    return (int)std::clamp<uint64_t>((rto_us + 999) / 1000, min_ms, max_ms);
+}
+
+int RttEstimator::timeout_ms(uint32_t ip, int attempt) const {
+    uint64_t ms = (uint64_t)timeout_ms(ip) << std::min(attempt, 16);
+    return (int)std::min<uint64_t>(ms, max_ms);
+}
+
+std::vector<RttEstimator::HostRtt> RttEstimator::snapshot() const {
+    std::vector<HostRtt> out;
+    for (const auto& st : stripes) {
+        std::lock_guard<std::mutex> lock(st.mtx);
+        for (const auto& kv : st.hosts) out.push_back(kv.second);
+    }
+    std::sort(out.begin(), out.end(),
+              [](const HostRtt& a, const HostRtt& b) { return a.ip < b.ip; });
+    return out;
+}
@@ -1,154 +1,635 @@
 #include "scanner.hpp"
+#include "connect_engine.hpp"
+#include "uring_engine.hpp"
+#include "synscan.hpp"
+#include "udp_engine.hpp"
+#include "discovery.hpp"
+#include "baseline.hpp"
+#include "banner.hpp"
+#include "ndjson_writer.hpp"
+#include "json_writer.hpp"
+#include "result_file.hpp"
 #include <iostream>
-#include <fstream>
-#include <sstream>
+#include <cstdio>
 #include <algorithm>
+#include <chrono>
+#include <condition_variable>
 #include <cstring>
-#include <netinet/in.h>
-#include <arpa/inet.h>
+#include <mutex>
+#include <random>
 #include <unistd.h>
 
-// --- Вспомогательная функция для экранирования JSON ---
-static std::string json_escape(const std::string& s) {
-    std::ostringstream oss;
-    for (char c : s) {
-        switch (c) {
-            case '\"': oss << "\\\""; break;
-            case '\\': oss << "\\\\"; break;
-            case '\n': oss << "\\n"; break;
-            case '\r': oss << "\\r"; break;
-            case '\t': oss << "\\t"; break;
-            default: oss << c; break;
-        }
-    }
-    return oss.str();
+static uint64_t pick_seed(uint64_t seed) {
+    if (seed != 0) return seed;
+    std::random_device rd;
+    return ((uint64_t)rd() << 32) | rd();
+}
+
+// Сколько проб воркер забирает из общего курсора за раз
+static constexpr uint64_t kClaimChunk = 64;
+// Открытых портов, ждущих стадию баннеров; дальше поиск ждёт её
+static constexpr size_t kBannerQueue = 1 << 16;
+
+static bool result_less(const ScanResult& a, const ScanResult& b) {
+    if (a.ip != b.ip) return a.ip < b.ip;
+    return a.port != b.port ? a.port < b.port : a.proto < b.proto;
+}
+
+// Проб шарда в пространстве из total проб
+static uint64_t shard_size(uint64_t total, const ScanOptions& opts) {
+    if (opts.shard_index >= total) return 0;
+    return (total - opts.shard_index + opts.shard_count - 1) / opts.shard_count;
+}
+
+// Хэш конфигурации для файла --resume: адреса целей и порты в порядке обхода
+static uint64_t config_digest(const TargetSet& targets, const std::vector<uint16_t>& ports,
+                              const std::vector<uint16_t>& udp_ports) {
+    uint64_t h = targets.digest();
+    auto mix = [&h](uint64_t v) {
+        h ^= v;
+        h *= 0x100000001b3ULL;
+    };
+    for (uint16_t p : ports) mix(p);
+    mix(0x10000);
+    for (uint16_t p : udp_ports) mix(p);
+    return h;
 }
 
 // --- Конструктор ---
-Scanner::Scanner(const std::string& ip, const std::vector<int>& ports,
-                 int threads, bool syn_mode, bool banner)
-    : target(ip), ports(ports), thread_count(threads),
-      syn_scan(syn_mode), banner_grab(banner) {}
+Scanner::Scanner(const std::string& target, const TargetSet& targets, const PortSet& ports,
+                 const PortSet& udp_ports, const ScanOptions& opts)
+    : target(target), targets(targets), opts(opts), seed(pick_seed(opts.seed)),
+      space(this->targets, ports.to_vector(), seed),
+      udp_space(this->targets, udp_ports.to_vector(), seed),
+      rtt(opts.timeout_ms, opts.min_timeout_ms, opts.max_timeout_ms) {
+    if (this->opts.by_frequency) {
+        std::vector<size_t> tiers;
+        std::vector<uint16_t> ranked = ports.by_frequency(false, tiers);
+        space = ProbeSpace(this->targets, ranked, seed, tiers);
+        ranked = udp_ports.by_frequency(true, tiers);
+        udp_space = ProbeSpace(this->targets, ranked, seed, tiers);
+    }
+}
+
+bool Scanner::resume_from(const std::string& path, std::string& err) {
+    ResumeFormat::Header h{};
+    h.config = config_digest(targets, space.port_list(), udp_space.port_list());
+    h.seed = seed;
+    h.shard_index = opts.shard_index;
+    h.shard_count = opts.shard_count;
+    h.tcp_probes = shard_size(space.size(), opts);
+    h.udp_probes = shard_size(udp_space.size(), opts);
+    auto state = std::make_unique<ResumeState>();
+    if (!state->open(path, h, err)) return false;
+    if (opts.seed != 0 && h.seed != opts.seed) {
+        err = path + ": state was written with --seed " + std::to_string(h.seed);
+        return false;
+    }
+    // Продолжение: тот же порядок проб, что у прерванного запуска
+    if (h.seed != seed) {
+        seed = h.seed;
+        space = ProbeSpace(targets, space.port_list(), seed, space.tier_ends());
+        udp_space = ProbeSpace(targets, udp_space.port_list(), seed, udp_space.tier_ends());
+    }
+    resume = std::move(state);
+    scan_stats.resumed = resume->resumed();
+    return true;
+}
+
+void Scanner::completed(const ProbeSpace& sp, uint64_t base, const ProbeTask& task) {
+    uint64_t k = 0;
+    if (!resume || !sp.index_of(task, k) || k % opts.shard_count != opts.shard_index) return;
+    resume->mark(base + k / opts.shard_count);
+}
+
+uint64_t Scanner::probe_count() const {
+    return head_probes + shard_size(space.size(), opts) + shard_size(udp_space.size(), opts);
+}
 
 // --- Основной запуск ---
-std::vector<ScanResult> Scanner::run() {
-    // Заполняем очередь портов
-    for (int p : ports) task_queue.push(p);
+uint64_t Scanner::run() {
+    if (opts.backend == ConnectBackend::URING && !UringEngine::supported()) {
+        std::cerr << "[!] io_uring недоступен в этом ядре, использую epoll\n";
+        opts.backend = ConnectBackend::EPOLL;
+    }
+
+    if (opts.rate > 0) rate = std::make_unique<RateController>(opts.rate);
+    // Пары baseline снимаются до discover(): упавший хост — это закрытые порты
+    if (baseline) collect_expected();
+    if (opts.discover) discover();
+    if (baseline) prioritize();
+
+    // Отметки --resume уходят в файл раз в kCheckpointMs, после fsync журнала
+    std::mutex checkpoint_mtx;
+    std::condition_variable checkpoint_cv;
+    bool scanning = true;
+    auto durable = [this]() {
+        if (stream) stream->sync();
+    };
+    std::thread checkpointer;
+    if (resume) {
+        checkpointer = std::thread([&]() {
+            std::unique_lock<std::mutex> lock(checkpoint_mtx);
+            while (!checkpoint_cv.wait_for(lock, std::chrono::milliseconds(ResumeState::kCheckpointMs),
+                                           [&] { return !scanning; })) {
+                resume->checkpoint(durable);
+            }
+        });
+    }
+
+    // Баннеры снимает отдельная стадия со своим бюджетом соединений
+    if (opts.grab_banner) {
+        banners = std::make_unique<BannerStage>(std::max(1, opts.banner_inflight),
+                                                opts.banner_timeout_ms, rtt, opts.retries,
+                                                kBannerQueue);
+        banners->start([this](const ProbeTask& task, const std::string& banner) {
+            ScanResult r{task.ip, task.port, true, banner, {}};
+            if (fingerprints) fingerprints->match(r.banner, r.service);
+            emit(banner_results.items, std::move(r));
+            completed(space, 0, task);
+        });
+    }
+
+    bool syn_done = opts.cutoff > 0 && (size_t)opts.cutoff < space.port_list().size()
+                        ? cutoff_scan() : tcp_pass();
 
-    // Запускаем потоки
-    std::vector<std::thread> workers;
-    for (int i = 0; i < thread_count; i++) {
-        workers.emplace_back(&Scanner::worker, this);
+    // UDP — после TCP, пока стадия баннеров дорабатывает найденное
+    if (udp_space.size() > 0) udp_scan();
+
+    // Поиск закончен — дожидаемся баннеров по уже найденным портам
+    if (banners) {
+        banners->finish();
+        banners.reset();
+        auto& items = banner_results.items;
+        results.insert(results.end(), std::make_move_iterator(items.begin()),
+                       std::make_move_iterator(items.end()));
+        items.clear();
+    }
+
+    if (resume) {
+        {
+            std::lock_guard<std::mutex> lock(checkpoint_mtx);
+            scanning = false;
+        }
+        checkpoint_cv.notify_one();
+        checkpointer.join();
+        resume->checkpoint(durable);
+    }
+
+    if (rate) {
+        scan_stats.paced = true;
+        scan_stats.rate = rate->stats();
+    }
+
+    // Сортировка результатов по адресу и порту
+    std::sort(results.begin(), results.end(), result_less);
+
+    return results.size() + (syn_done && !opts.grab_banner ? syn_open.size() : 0);
+}
+
+bool Scanner::tcp_pass() {
+    bool syn_done = false;
+#ifdef __linux__
+    syn_done = opts.syn_mode && space.size() > 0 && syn_scan();
+#endif
+
+    if (!syn_done && space.size() > 0) {
+        // Запускаем потоки, у каждого свой буфер результатов
+        thread_results.assign(std::max(1, opts.threads), ResultBuffer{});
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < thread_results.size(); i++) {
+            workers.emplace_back(&Scanner::worker, this, i);
+        }
+
+        // Ждём завершения и сливаем буферы
+        for (auto& t : workers) t.join();
+        for (auto& buf : thread_results) {
+            results.insert(results.end(), std::make_move_iterator(buf.items.begin()),
+                           std::make_move_iterator(buf.items.end()));
+        }
+        thread_results.clear();
     }
+    return syn_done;
+}
 
-    // Ждём завершения
-    for (auto& t : workers) t.join();
+// --- Отсечка по частым портам (--cutoff) ---
+// Порты уже в порядке частоты: первый проход — первые cutoff портов у всех
+// хостов; хост без единого открытого среди них дальше не сканируется
+bool Scanner::cutoff_scan() {
+    const std::vector<uint16_t> ports = space.port_list();
+    size_t n = (size_t)opts.cutoff;
+    std::vector<size_t> head_tiers, tail_tiers;
+    for (size_t end : space.tier_ends()) {
+        if (end < n) head_tiers.push_back(end);
+        if (end > n) tail_tiers.push_back(end - n);
+    }
+    uint64_t planned = shard_size(space.size(), opts);
 
-    // Сортировка результатов по номеру порта
-    std::sort(results.begin(), results.end(),
-              [](const ScanResult& a, const ScanResult& b) {
-                  return a.port < b.port;
-              });
+    host_hit.reset(new std::atomic<uint8_t>[targets.size()]());
+    space = ProbeSpace(targets, {ports.begin(), ports.begin() + n}, seed, head_tiers);
+    bool syn_done = tcp_pass();
+    head_probes = shard_size(space.size(), opts);
 
-    return results;
+    tail_targets = targets.subset([this](uint64_t i) { return host_hit[i].load() != 0; });
+    space = ProbeSpace(tail_targets, {ports.begin() + n, ports.end()}, seed, tail_tiers);
+    scan_stats.cutoff_hosts = targets.size() - tail_targets.size();
+    scan_stats.cutoff_skipped = planned - head_probes - shard_size(space.size(), opts);
+
+    // Второй проход — тем же способом, что и первый; курсор — с начала нового пространства
+    opts.syn_mode = syn_done;
+    cursor.store(0);
+    if (space.size() > 0 && !stopping.load()) tcp_pass();
+    return syn_done;
+}
+
+void Scanner::hit(uint32_t ip) {
+    uint64_t i = 0;
+    if (host_hit && targets.index_of(ip, i)) host_hit[i].store(1, std::memory_order_relaxed);
+}
+
+void Scanner::for_each_result(const std::function<void(const ScanResult&)>& fn) const {
+    for (const auto& r : results) fn(r);
+    // С баннерами находки SYN-скана уже в results
+    if (opts.grab_banner) return;
+    ScanResult syn{0, 0, true, "", {}};
+    syn_open.for_each([&](uint32_t ip, uint16_t port) {
+        syn.ip = ip;
+        syn.port = port;
+        fn(syn);
+    });
 }
 
 // --- Сохранение JSON ---
 void Scanner::save_json(const std::string& path) const {
-    std::ofstream out(path);
-    if (!out.is_open()) return;
+    FILE* f = std::fopen(path.c_str(), "w");
+    if (!f) return;
 
-    out << "{\n";
-    out << "  \"target\": \"" << json_escape(target) << "\",\n";
-    out << "  \"results\": [\n";
+    JsonWriter::Document doc(f);
+    doc.begin(target);
+    for_each_result([&](const ScanResult& r) {
+        doc.result(r.ip, (uint16_t)r.port, r.proto, r.open, r.banner, r.service.service,
+                   r.service.product, r.service.version);
+    });
 
-    for (size_t i = 0; i < results.size(); i++) {
-        const auto& r = results[i];
-        out << "    {\"port\": " << r.port
-            << ", \"open\": " << (r.open ? "true" : "false")
-            << ", \"banner\": \"" << json_escape(r.banner) << "\"}";
-        if (i + 1 < results.size()) out << ",";
-        out << "\n";
+    // Выученный RTT по хостам, которые хоть раз ответили
+    doc.hosts();
+    for (const auto& h : rtt.snapshot()) {
+        doc.host(h.ip, h.srtt_us, h.rttvar_us, (uint32_t)rtt.timeout_ms(h.ip), h.samples);
     }
+    doc.end();
+    std::fclose(f);
+}
 
-    out << "  ]\n";
-    out << "}\n";
+// --- Сохранение в двоичном формате (.scnr) ---
+bool Scanner::save_binary(const std::string& path) const {
+    ResultFileWriter out;
+    if (!out.open(path, target)) return false;
+    // Хосты первыми — тогда таблица хостов идёт в том же порядке, что "hosts" в JSON
+    for (const auto& h : rtt.snapshot()) out.add_host(h, rtt.timeout_ms(h.ip));
+    for_each_result([&](const ScanResult& r) { out.add(r); });
+    return out.finish();
 }
 
 // --- Поток-воркер ---
-void Scanner::worker() {
+void Scanner::worker(size_t id) {
+    auto& out = thread_results[id].items;
+    Claim claim;
+    // SYN-скан сюда попадает только как fallback (macOS, нет root)
+    if (opts.backend == ConnectBackend::URING) {
+        uring_worker(claim, out);
+    } else {
+        connect_worker(claim, out);
+    }
+}
+
+// Находка — в поток NDJSON, если он задан, иначе в буфер потока
+void Scanner::emit(std::vector<ScanResult>& out, ScanResult r) {
+    if (stream) {
+        stream->push(r);
+    } else {
+        out.push_back(std::move(r));
+    }
+}
+
+void Scanner::found(std::vector<ScanResult>& out, const ProbeTask& task) {
+    hit(task.ip);
+    if (banners) {
+        banners->push(task);
+    } else {
+        emit(out, {task.ip, task.port, true, "", {}});
+    }
+}
+
+// Следующая проба шарда: сначала из своей пачки, пустая пачка добирается
+// из общего атомарного курсора. Сделанные прошлым запуском (--resume) пропускаются.
+// С --baseline пачки сперва берутся из priority, а общий обход пропускает эти пары
+bool Scanner::next_task(Claim& claim, ProbeTask& task) {
     while (true) {
-        int port;
-        {
-            std::unique_lock<std::mutex> lock(queue_mtx);
-            if (task_queue.empty()) return;
-            port = task_queue.front();
-            task_queue.pop();
+        if (claim.next == claim.end) {
+            if (stopping.load(std::memory_order_relaxed)) return false;
+            uint64_t i = priority.size();
+            if (priority_cursor.load(std::memory_order_relaxed) < priority.size()) {
+                i = priority_cursor.fetch_add(kClaimChunk, std::memory_order_relaxed);
+            }
+            if (i < priority.size()) {
+                claim = {i, std::min<uint64_t>(priority.size(), i + kClaimChunk), true};
+            } else {
+                uint64_t total = shard_size(space.size(), opts);
+                uint64_t k = cursor.fetch_add(kClaimChunk, std::memory_order_relaxed);
+                if (k >= total) return false;
+                claim = {k, std::min(total, k + kClaimChunk), false};
+            }
         }
+        uint64_t k = claim.listed ? priority[claim.next++] : claim.next++;
+        if (skip_done(k)) continue;
+        task = space.at(opts.shard_index + k * opts.shard_count);
+        if (!claim.listed && baseline && baseline->contains(task.ip, task.port, Proto::TCP)) continue;
+        return true;
+    }
+}
+
+// --- TCP connect scan: один epoll-движок на поток ---
+// carry — пробы, оставшиеся от упавшего io_uring-движка; идут первыми
+void Scanner::connect_worker(Claim& claim, std::vector<ScanResult>& out,
+                             std::vector<ProbeTask> carry) {
+    ConnectEngine engine(opts.max_inflight, rtt, opts.retries, false, 0);
+    engine.pace_with(rate.get());
+    engine.run(
+        [this, &carry, &claim](ProbeTask& task) {
+            if (carry.empty()) return next_task(claim, task);
+            task = carry.back();
+            carry.pop_back();
+            return true;
+        },
+        [this, &out](const ProbeTask& task, bool open, const std::string&) {
+            if (open) found(out, task);
+            // Открытый порт с -b отметит стадия баннеров, когда снимет баннер
+            if (!open || !banners) completed(space, 0, task);
+        });
+}
 
-        std::string banner;
-        bool is_open = false;
+// --- TCP connect scan через io_uring ---
+void Scanner::uring_worker(Claim& claim, std::vector<ScanResult>& out) {
+    UringEngine engine(opts.max_inflight, rtt, opts.retries);
+    engine.pace_with(rate.get());
+    bool ok = engine.run(
+        [this, &claim](ProbeTask& task) { return next_task(claim, task); },
+        [this, &out](const ProbeTask& task, bool open) {
+            if (open) found(out, task);
+            if (!open || !banners) completed(space, 0, task);
+        });
+    if (!ok) {
+        // кольцо не создалось или сломалось — доскан этим потоком через epoll
+        std::cerr << "[!] io_uring: " << std::strerror(engine.last_error())
+                  << ", поток переходит на epoll\n";
+        // остаток своей пачки в claim доберёт он же
+        connect_worker(claim, out, engine.unfinished());
+    }
+}
 
-        if (syn_scan) {
+// --- SYN scan: один stateless-движок на всю очередь ---
+// false — движок не поднялся (нет root/маршрута), вызывающий переходит на connect
+bool Scanner::syn_scan() {
 #ifdef __linux__
-            is_open = scan_tcp_syn(port); // полноценный SYN только на Linux
+    SynEngine engine(rtt, opts.retries, (size_t)std::max(1, opts.syn_inflight), opts.min_timeout_ms);
+    if (!engine.open(targets.first_ip(), targets.last_ip())) {
+        std::cerr << "[-] SYN-скан недоступен (нужен root и маршрут до цели), использую TCP connect\n";
+        return false;
+    }
+    engine.pace_with(rate.get());
+
+    // Движок без состояния: повторные SYN-ACK на ту же пару отсеивает syn_open.
+    // Колбэк зовёт только поток приёма, так что блокировки не нужны.
+    Claim claim;
+    engine.run(
+        [this, &claim](ProbeTask& task) { return next_task(claim, task); },
+        [this](const ProbeTask& task, bool open) {
+            if (!open) {
+                completed(space, 0, task);
+                return;
+            }
+            hit(task.ip);
+            if (!syn_open.insert(task.ip, task.port)) return;
+            if (banners) {
+                banners->push(task);
+                return;
+            }
+            if (stream) stream->push({task.ip, task.port, true, ""});
+            completed(space, 0, task);
+        },
+        [this](const ProbeTask& task) { completed(space, 0, task); });
+
+    if (engine.send_failures() > 0) {
+        std::cerr << "[!] " << engine.send_failures() << " SYN не отправлено: "
+                  << std::strerror(engine.last_error()) << "\n";
+    }
+    // С --cutoff движков два, счётчики суммируются
+    uint64_t drops = engine.ring_mode() ? engine.kernel_drops() : 0;
+    scan_stats.kernel_drops += drops;
+    scan_stats.filter_counting = engine.filter_counting();
+    scan_stats.filtered += engine.filtered_packets();
+    if (drops > 0) {
+        std::cerr << "[!] Ядро отбросило " << drops
+                  << " ответов: кольцо приёма переполнено, результаты неполные\n";
+    }
+    return true;
 #else
-            is_open = scan_tcp_connect(port, banner); // fallback для macOS
+    return false;
 #endif
-        } else {
-            is_open = scan_tcp_connect(port, banner);
-        }
+}
 
-        if (is_open) {
-            std::lock_guard<std::mutex> lock(results_mtx);
-            results.push_back({port, true, banner});
-        }
+// --- Поиск живых хостов перед сканом портов ---
+void Scanner::discover() {
+#ifdef __linux__
+    auto t0 = std::chrono::steady_clock::now();
+    HostDiscovery hosts(targets, rtt, 1 + std::max(0, opts.retries), opts.timeout_ms, seed);
+    if (!hosts.open()) {
+        std::cerr << "[-] Поиск хостов недоступен (нужен root): " << std::strerror(errno)
+                  << ", сканирую все цели\n";
+        return;
+    }
+    hosts.pace_with(rate.get());
+    TargetSet alive = hosts.run();
+
+    const auto& st = hosts.stats();
+    scan_stats.discovered = true;
+    scan_stats.hosts_total = targets.size();
+    scan_stats.hosts_alive = alive.size();
+    scan_stats.alive_arp = st.by_arp;
+    scan_stats.alive_icmp = st.by_icmp;
+    scan_stats.alive_tcp = st.by_tcp;
+    scan_stats.discover_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                 std::chrono::steady_clock::now() - t0).count();
+    if (st.send_failures > 0) {
+        std::cerr << "[!] " << st.send_failures << " проб поиска хостов не отправлено: "
+                  << std::strerror(st.last_error) << "\n";
+    }
+    if (alive.empty()) {
+        std::cerr << "[!] Ни один из " << targets.size() << " хостов не ответил на поиск\n";
     }
+
+    // Пространства проб держат указатель на targets, перестановку строим под новый размер
+    targets = std::move(alive);
+    space = ProbeSpace(targets, space.port_list(), seed, space.tier_ends());
+    udp_space = ProbeSpace(targets, udp_space.port_list(), seed, udp_space.tier_ends());
+#else
+    std::cerr << "[-] Поиск хостов поддерживается только в Linux, сканирую все цели\n";
+#endif
 }
 
-// --- TCP connect scan ---
-bool Scanner::scan_tcp_connect(int port, std::string& banner) {
-    int sock = socket(AF_INET, SOCK_STREAM, 0);
-    if (sock < 0) return false;
+// --- Дифференциальный скан (--baseline) ---
+void Scanner::collect_expected() {
+    baseline->for_each([this](uint32_t ip, uint16_t port, Proto proto) {
+        uint64_t k = 0;
+        if (!(proto == Proto::UDP ? udp_space : space).index_of({ip, port}, k) ||
+            k % opts.shard_count != opts.shard_index) {
+            return;
+        }
+        expected.push_back(Baseline::key(ip, port, proto));
+    });
+    std::sort(expected.begin(), expected.end());
+}
+
+// Номера проб по возрастанию — пары идут в порядке перестановки, как и весь скан
+void Scanner::prioritize() {
+    for (uint64_t key : expected) {
+        ProbeTask task{Baseline::key_ip(key), Baseline::key_port(key)};
+        bool udp = Baseline::key_proto(key) == Proto::UDP;
+        uint64_t k = 0;
+        if (!(udp ? udp_space : space).index_of(task, k)) continue;  // хост не ответил на discover
+        (udp ? udp_priority : priority).push_back(k / opts.shard_count);
+    }
+    std::sort(priority.begin(), priority.end());
+    std::sort(udp_priority.begin(), udp_priority.end());
+    scan_stats.baseline_probes = priority.size() + udp_priority.size();
+}
 
-    sockaddr_in addr{};
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(port);
-    inet_pton(AF_INET, target.c_str(), &addr.sin_addr);
+// Баннеры сравниваются, только если они снимались (-b; у UDP — всегда); при
+// опознанном с обеих сторон сервисе сравнивается он, а не сам баннер — в том же
+// HTTP-ответе меняются Date и прочие заголовки
+static bool service_changed(const ScanResult& now, const Baseline::Entry& was) {
+    if (!now.service.service.empty() && !was.service.service.empty()) {
+        return now.service.service != was.service.service ||
+               now.service.product != was.service.product ||
+               now.service.version != was.service.version;
+    }
+    // У UDP в ответе бывают случайные поля (id запроса DNS), без опознания не сравниваем
+    return now.proto == Proto::TCP && now.banner != was.banner;
+}
 
-    bool success = (connect(sock, (sockaddr*)&addr, sizeof(addr)) == 0);
+bool Scanner::save_diff(const std::string& path, const std::string& baseline_name,
+                        DiffSummary& summary) const {
+    std::vector<ScanResult> now;
+    for_each_result([&](const ScanResult& r) {
+        if (r.open) now.push_back(r);
+    });
+    std::sort(now.begin(), now.end(), result_less);
 
-    if (success && banner_grab) {
-        banner = grab_banner_from_socket(sock);
+    FILE* f = std::fopen(path.c_str(), "w");
+    if (!f) {
+        std::cerr << "[-] " << path << ": " << std::strerror(errno) << "\n";
+        return false;
     }
+    summary = {};
+    summary.baseline = expected.size();
+    JsonWriter::Document doc(f);
+    doc.begin_diff(target, baseline_name);
 
-    close(sock);
-    return success;
+    // Слияние двух отсортированных списков: только сейчас — opened, только в baseline — closed
+    size_t i = 0, j = 0;
+    while (i < now.size() || j < expected.size()) {
+        uint64_t a = i < now.size() ? Baseline::key(now[i].ip, (uint16_t)now[i].port, now[i].proto)
+                                    : UINT64_MAX;
+        uint64_t b = j < expected.size() ? expected[j] : UINT64_MAX;
+        if (a < b) {
+            doc.change("opened", now[i], nullptr);
+            ++summary.opened;
+            ++i;
+        } else if (b < a) {
+            ScanResult gone{Baseline::key_ip(b), Baseline::key_port(b), false, "", {},
+                            Baseline::key_proto(b)};
+            doc.change("closed", gone, baseline->entry(gone.ip, (uint16_t)gone.port, gone.proto));
+            ++summary.closed;
+            ++j;
+        } else {
+            const ScanResult& r = now[i];
+            const Baseline::Entry* was = baseline->entry(r.ip, (uint16_t)r.port, r.proto);
+            bool grabbed = r.proto == Proto::UDP || opts.grab_banner;
+            if (grabbed && was && service_changed(r, *was)) {
+                doc.change("changed", r, was);
+                ++summary.changed;
+            } else {
+                ++summary.confirmed;
+            }
+            ++i;
+            ++j;
+        }
+    }
+    doc.end_diff(summary);
+    bool ok = std::ferror(f) == 0;
+    ok = std::fclose(f) == 0 && ok;
+    if (!ok) std::cerr << "[-] " << path << ": write failed\n";
+    return ok;
 }
 
-// --- SYN scan (только Linux, заглушка для macOS) ---
-bool Scanner::scan_tcp_syn(int port) {
+// --- UDP scan: один движок, пробы шарда по порядку перестановки ---
+void Scanner::udp_scan() {
 #ifdef __linux__
-    // Здесь должна быть реализация через raw-сокеты
-    // Для упрощения сейчас возвращаем false
-    (void)port;
-    return false;
-#else
-    (void)port;
-    return false;
-#endif
-}
+    UdpEngine engine(rtt, opts.udp_retries, (size_t)std::max(1, opts.syn_inflight), opts.udp_rate);
+    if (!engine.open()) {
+        std::cerr << "[-] UDP-скан недоступен: " << std::strerror(errno) << "\n";
+        return;
+    }
+    engine.pace_with(rate.get());
+    if (!engine.icmp_raw()) {
+        std::cerr << "[!] Нет raw-сокета ICMP (нужен root), закрытые UDP-порты ловлю через IP_RECVERR\n";
+    }
 
-// --- Banner grabbing ---
-std::string Scanner::grab_banner_from_socket(int sock) {
-    const char* probe = "HEAD / HTTP/1.0\r\n\r\n";
-    send(sock, probe, strlen(probe), 0);
+    // Биты UDP-проб в карте --resume идут после TCP
+    uint64_t base = shard_size(space.size(), opts);
+    uint64_t total = shard_size(udp_space.size(), opts);
+    uint64_t k = 0;
+    size_t listed = 0;
+    engine.run(
+        [&](ProbeTask& task) {
+            if (stopping.load(std::memory_order_relaxed)) return false;
+            // Пары из --baseline — первыми
+            while (listed < udp_priority.size()) {
+                uint64_t j = udp_priority[listed++];
+                if (skip_done(base + j)) continue;
+                task = udp_space.at(opts.shard_index + j * opts.shard_count);
+                return true;
+            }
+            while (k < total) {
+                uint64_t j = k++;
+                if (skip_done(base + j)) continue;
+                task = udp_space.at(opts.shard_index + j * opts.shard_count);
+                if (baseline && baseline->contains(task.ip, task.port, Proto::UDP)) continue;
+                return true;
+            }
+            return false;
+        },
+        [this, base](const ProbeTask& task, UdpEngine::Reply reply, const char* data, size_t n) {
+            if (reply == UdpEngine::Reply::CLOSED) {
+                ++scan_stats.udp_closed;
+            } else if (reply == UdpEngine::Reply::FILTERED) {
+                ++scan_stats.udp_filtered;
+            } else {
+                ScanResult r{task.ip, task.port, true, {}, {}, Proto::UDP};
+                append_banner(r.banner, data, (long)n);
+                if (fingerprints) fingerprints->match(r.banner, r.service);
+                emit(results, std::move(r));
+            }
+            completed(udp_space, base, task);
+        },
+        [this, base](const ProbeTask& task) { completed(udp_space, base, task); });
+    scan_stats.udp_silent = engine.silent();
 
-    char buf[256];
-    int n = recv(sock, buf, sizeof(buf) - 1, 0);
-    if (n > 0) {
-        buf[n] = '\0';
-        return std::string(buf);
+    if (engine.send_failures() > 0) {
+        std::cerr << "[!] " << engine.send_failures() << " UDP-проб не отправлено: "
+                  << std::strerror(engine.last_error()) << "\n";
     }
-    return {};
+#else
+    std::cerr << "[-] UDP-скан поддерживается только в Linux\n";
+#endif
 }
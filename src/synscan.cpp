@@ -1,112 +1,314 @@
 #include "synscan.hpp"
+#include "packet_template.hpp"
+#include "timing_wheel.hpp"
+#include "utils.hpp"
 
 #ifdef __linux__
 #include <netinet/ip.h>
 #include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
+#include <poll.h>
 #include <unistd.h>
+#include <cerrno>
+#include <algorithm>
+#include <chrono>
 #include <cstring>
-#include <cstdlib>
-#include <ctime>
 #include <iostream>
+#include <random>
+#include <vector>
+#include <thread>
 
-struct pseudo_header {
-    uint32_t src;
-    uint32_t dst;
-    uint8_t zero;
-    uint8_t proto;
-    uint16_t len;
-};
-
-static uint16_t csum(const uint16_t* ptr, size_t nbytes) {
-    uint32_t sum = 0;
-    while (nbytes > 1) {
-        sum += *ptr++;
-        nbytes -= 2;
+// Диапазон портов источника, из которого движок шлёт SYN
+static const uint16_t kSrcPortBase = 40000;
+static const uint16_t kSrcPortRange = 20000;
+
+// SYN на один вызов sendmmsg()
+static const int kSendBatch = 256;
+// Сколько ждать освобождения буфера отправки, прежде чем бросить пакет
+static const uint64_t kSendStallMs = 200;
+
+static uint64_t mono_ms() {
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static uint64_t mono_us() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// SipHash-2-4 от одного 64-битного слова
+static uint64_t siphash24(const uint64_t key[2], uint64_t m) {
+    auto rotl = [](uint64_t x, int b) { return (x << b) | (x >> (64 - b)); };
+    uint64_t v0 = 0x736f6d6570736575ULL ^ key[0];
+    uint64_t v1 = 0x646f72616e646f6dULL ^ key[1];
+    uint64_t v2 = 0x6c7967656e657261ULL ^ key[0];
+    uint64_t v3 = 0x7465646279746573ULL ^ key[1];
+    auto round = [&]() {
+        v0 += v1; v1 = rotl(v1, 13); v1 ^= v0; v0 = rotl(v0, 32);
+        v2 += v3; v3 = rotl(v3, 16); v3 ^= v2;
+        v0 += v3; v3 = rotl(v3, 21); v3 ^= v0;
+        v2 += v1; v1 = rotl(v1, 17); v1 ^= v2; v2 = rotl(v2, 32);
+    };
+    const uint64_t b = 8ULL << 56;
+    v3 ^= m; round(); round(); v0 ^= m;
+    v3 ^= b; round(); round(); v0 ^= b;
+    v2 ^= 0xff; round(); round(); round(); round();
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+// --- Конструктор ---
+SynEngine::SynEngine(RttEstimator& rtt, int retries, size_t max_outstanding, int wait_ms)
+    : rtt(rtt), retries(std::clamp(retries, 0, 255)), wait_ms(wait_ms), inflight(max_outstanding) {
+    std::random_device rd;
+    key[0] = ((uint64_t)rd() << 32) | rd();
+    key[1] = ((uint64_t)rd() << 32) | rd();
+}
+
+SynEngine::~SynEngine() {
+    if (send_fd >= 0) close(send_fd);
+    if (recv_fd >= 0) close(recv_fd);
+}
+
+bool SynEngine::open(uint32_t first_ip, uint32_t last_ip) {
+    src_ip = route_source_ip(first_ip);
+    if (src_ip == 0) return false;
+
+    // IPPROTO_RAW подразумевает IP_HDRINCL
+    send_fd = socket(AF_INET, SOCK_RAW, IPPROTO_RAW);
+    if (send_fd < 0) return false;
+    int sndbuf = 4 << 20;
+    setsockopt(send_fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+    // Без IP_RECVERR raw-сокет молча глотает ENOBUFS от переполненной очереди
+    // устройства (qdisc), и пакет пропадает незаметно; с ним flush() ждёт и
+    // досылает, а контроллер темпа видит потерю
+    int on = 1;
+    setsockopt(send_fd, SOL_IP, IP_RECVERR, &on, sizeof(on));
+
+    // Приём — через кольцо TPACKET_V3, иначе отдельным TCP raw-сокетом
+    if (!ring.open()) {
+        recv_fd = socket(AF_INET, SOCK_RAW, IPPROTO_TCP);
+        if (recv_fd < 0) return false;
+        int rcvbuf = 8 << 20;
+        setsockopt(recv_fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
     }
-    if (nbytes == 1) {
-        uint16_t odd = 0;
-        *(uint8_t*)(&odd) = *(uint8_t*)ptr;
-        sum += odd;
+
+    // Без фильтра скан работает, просто разбор чужого трафика ляжет на on_packet()
+    ReplyFilter::Spec spec{src_ip, first_ip, last_ip, kSrcPortBase,
+                           (uint16_t)(kSrcPortBase + kSrcPortRange - 1)};
+    if (!filter.attach(ring.is_open() ? ring.fd() : recv_fd, spec)) {
+        std::cerr << "[!] Не удалось повесить BPF-фильтр на сокет приёма: "
+                  << std::strerror(errno) << "\n";
     }
-    sum = (sum >> 16) + (sum & 0xffff);
-    sum += (sum >> 16);
-    return (uint16_t)(~sum);
+    return true;
+}
+
+// --- Куки: ключевой хэш вместо таблицы проб ---
+uint32_t SynEngine::cookie(uint32_t ip, uint16_t port, uint16_t sport) const {
+    return (uint32_t)siphash24(key, ((uint64_t)ip << 32) | ((uint64_t)port << 16) | sport);
 }
 
-bool syn_probe_linux(const std::string& dst_ip, int port, int timeout_ms) {
-    int sock = socket(AF_INET, SOCK_RAW, IPPROTO_TCP);
-    if (sock < 0) return false;
+uint16_t SynEngine::source_port(uint32_t ip, uint16_t port) const {
+    return kSrcPortBase + cookie(ip, port, 0) % kSrcPortRange;
+}
 
-    int one = 1;
-    if (setsockopt(sock, IPPROTO_IP, IP_HDRINCL, &one, sizeof(one)) < 0) {
-        close(sock);
-        return false;
+// --- Отправка пачки: MSG_DONTWAIT, частичные отправки досылаются ---
+// SYN на хосты без ARP-ответа копятся в очереди соседа и держат память сокета;
+// блокирующий sendmmsg в этом случае зависает
+void SynEngine::flush(mmsghdr* msgs, int n) {
+    int sent = 0;
+    uint64_t stalled_since = 0;
+    while (sent < n) {
+        int r = sendmmsg(send_fd, &msgs[sent], n - sent, MSG_DONTWAIT);
+        if (r > 0) {
+            sent += r;
+            stalled_since = 0;
+        } else if (errno == ENOBUFS || errno == EAGAIN || errno == EINTR) {
+            uint64_t now = mono_ms();
+            if (stalled_since == 0) {
+                stalled_since = now;
+                // Очередь на отправку переполнена — отправляем быстрее, чем уходит
+                if (rate && errno == ENOBUFS) rate->dropped(1);
+            }
+            if (now - stalled_since < kSendStallMs) {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+                continue;
+            }
+            // Буфер так и не освободился — жертвуем пакетом, чтобы скан шёл дальше
+            ++send_errors;
+            last_send_errno = errno;
+            ++sent;
+            stalled_since = 0;
+        } else {
+            // EPERM от файрвола, EHOSTUNREACH и т.п. — пакет на голове пачки
+            // потерян, учитываем и идём дальше
+            ++send_errors;
+            last_send_errno = errno;
+            ++sent;
+        }
     }
+}
+
+// --- Поток отправки: новые пробы и повторы по колесу таймеров ---
+void SynEngine::sender(const NextProbeFn& next, const ExpiredFn& on_expired) {
+    SynTemplate tmpl(src_ip);
+    TimingWheel timers(mono_ms());
+    std::vector<uint8_t> packets(kSendBatch * kSynPacketLen);
+    std::vector<sockaddr_in> dsts(kSendBatch);
+    std::vector<iovec> iovs(kSendBatch);
+    std::vector<mmsghdr> msgs(kSendBatch);
+    int n = 0;
+
+    // Пакет в пачку; повтор собирается так же — sport и seq детерминированы
+    auto queue = [&](uint32_t ip, uint16_t port) {
+        uint16_t sport = source_port(ip, port);
+        uint8_t* pkt = &packets[n * kSynPacketLen];
+        tmpl.build(pkt, ip, sport, port, cookie(ip, port, sport));
+
+        dsts[n] = {};
+        dsts[n].sin_family = AF_INET;
+        dsts[n].sin_addr.s_addr = htonl(ip);
+        iovs[n] = {pkt, kSynPacketLen};
+        msgs[n] = {};
+        msgs[n].msg_hdr.msg_name = &dsts[n];
+        msgs[n].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+        msgs[n].msg_hdr.msg_iov = &iovs[n];
+        msgs[n].msg_hdr.msg_iovlen = 1;
+        if (++n == kSendBatch) {
+            flush(msgs.data(), n);
+            n = 0;
+        }
+    };
+
+    // Таймаут пробы: ответа нет — повторяем, пока не кончились попытки
+    auto on_timer = [&](uint64_t key) {
+        uint32_t ip = (uint32_t)(key >> 16);
+        uint16_t port = (uint16_t)key;
+        uint8_t attempt = 0;
+        bool answered = false;
+        if (!inflight.lookup(ip, port, attempt, answered)) return;
+        if (!answered && attempt >= retries) {
+            inflight.erase(ip, port);
+            if (on_expired) on_expired({ip, port});
+            return;
+        }
+        if (answered || !inflight.retry(ip, port, attempt + 1, mono_us())) {
+            inflight.erase(ip, port);
+            return;
+        }
+        queue(ip, port);
+        if (rate) rate->charge(1);
+        timers.add(mono_ms() + (uint64_t)rtt.timeout_ms(ip, attempt + 1), key);
+    };
 
-    char packet[sizeof(iphdr) + sizeof(tcphdr)]{};
-    auto* iph = (iphdr*)packet;
-    auto* tcph = (tcphdr*)(packet + sizeof(iphdr));
-
-    iph->ihl = 5;
-    iph->version = 4;
-    iph->tot_len = htons(sizeof(packet));
-    iph->ttl = 64;
-    iph->protocol = IPPROTO_TCP;
-    inet_pton(AF_INET, dst_ip.c_str(), &iph->daddr);
-
-    tcph->source = htons(40000 + rand() % 20000);
-    tcph->dest = htons(port);
-    tcph->seq = htonl(rand());
-    tcph->doff = sizeof(tcphdr) / 4;
-    tcph->syn = 1;
-    tcph->window = htons(65535);
-
-    pseudo_header psh{};
-    psh.src = iph->saddr;
-    psh.dst = iph->daddr;
-    psh.proto = IPPROTO_TCP;
-    psh.len = htons(sizeof(tcphdr));
-
-    char pseudo[sizeof(psh) + sizeof(tcphdr)];
-    memcpy(pseudo, &psh, sizeof(psh));
-    memcpy(pseudo + sizeof(psh), tcph, sizeof(tcphdr));
-    tcph->check = csum((uint16_t*)pseudo, sizeof(pseudo));
-
-    sockaddr_in dst{};
-    dst.sin_family = AF_INET;
-    dst.sin_port = tcph->dest;
-    inet_pton(AF_INET, dst_ip.c_str(), &dst.sin_addr);
-
-    if (sendto(sock, packet, sizeof(packet), 0, (sockaddr*)&dst, sizeof(dst)) < 0) {
-        close(sock);
-        return false;
+    bool more = true;
+    while (more || !timers.empty()) {
+        timers.advance(mono_ms(), on_timer);
+
+        // Новые пробы — пока есть место в таблице и токены, иначе ждём таймаутов и ответов
+        ProbeTask t{};
+        uint64_t now_ms = mono_ms();
+        uint64_t now_us = mono_us();
+        int budget = kSendBatch;
+        if (rate && more && !inflight.full()) budget = (int)rate->take(kSendBatch);
+        for (int i = 0; more && i < budget && !inflight.full() && (more = next(t)); ++i) {
+            inflight.insert(t.ip, t.port, now_us);
+            queue(t.ip, t.port);
+            timers.add(now_ms + (uint64_t)rtt.timeout_ms(t.ip), ((uint64_t)t.ip << 16) | t.port);
+        }
+        if (n > 0) {
+            flush(msgs.data(), n);
+            n = 0;
+        }
+        last_send_ms = mono_ms();
+
+        // Новых проб нет, таблица полна или кончились токены — спим до ближайшего
+        // таймаута или токена
+        if (!more || inflight.full()) {
+            int wait = timers.next_timeout_ms(mono_ms());
+            if (wait > 0) std::this_thread::sleep_for(std::chrono::milliseconds(std::min(wait, 10)));
+        } else if (budget == 0) {
+            int wait = std::min(rate->wait_ms(), 10);
+            int timer = timers.next_timeout_ms(mono_ms());
+            if (timer >= 0) wait = std::min(wait, timer);
+            if (wait > 0) std::this_thread::sleep_for(std::chrono::milliseconds(wait));
+        }
     }
+    last_send_ms = mono_ms();
+    sending = false;
+}
 
-    fd_set rfds;
-    FD_ZERO(&rfds);
-    FD_SET(sock, &rfds);
-    timeval tv{timeout_ms / 1000, (timeout_ms % 1000) * 1000};
+// --- Разбор ответа: SYN-ACK или RST на наш SYN ---
+void SynEngine::on_packet(const uint8_t* pkt, size_t n, const ReplyFn& on_reply) {
+    auto* rip = (const iphdr*)pkt;
+    if (n < sizeof(iphdr) || rip->protocol != IPPROTO_TCP) return;
+    if (n < rip->ihl * 4 + sizeof(tcphdr)) return;
+    if (ntohl(rip->daddr) != src_ip) return;
+    auto* rtcp = (const tcphdr*)(pkt + rip->ihl * 4);
 
-    int sel = select(sock + 1, &rfds, nullptr, nullptr, &tv);
-    if (sel <= 0) { close(sock); return false; }
+    bool syn_ack = rtcp->syn && rtcp->ack;
+    if (!syn_ack && !rtcp->rst) return;
 
-    char buf[2048];
-    sockaddr_in from{};
-    socklen_t fromlen = sizeof(from);
-    int n = recvfrom(sock, buf, sizeof(buf), 0, (sockaddr*)&from, &fromlen);
-    close(sock);
-    if (n < (int)(sizeof(iphdr) + sizeof(tcphdr))) return false;
+    uint32_t ip = ntohl(rip->saddr);
+    uint16_t port = ntohs(rtcp->source);
+    uint16_t sport = ntohs(rtcp->dest);
+    if (sport != source_port(ip, port)) return;
+    if (ntohl(rtcp->ack_seq) != cookie(ip, port, sport) + 1) return;
 
-    auto* rip = (iphdr*)buf;
-    if (rip->protocol != IPPROTO_TCP) return false;
-    auto* rtcp = (tcphdr*)(buf + rip->ihl * 4);
+    // Снимаем пробу с повторов; RTT — только по первой попытке (алгоритм Карна:
+    // у повтора тот же seq, и непонятно, на какую из попыток пришёл ответ)
+    uint8_t attempt = 0;
+    uint64_t sent_us = 0;
+    if (inflight.mark_answered(ip, port, attempt, sent_us)) {
+        if (attempt == 0) rtt.sample(ip, mono_us() - sent_us);
+        if (rate) rate->answered(attempt);
+    }
 
-    bool syn_set = rtcp->syn;
-    bool ack_set = rtcp->ack;
-    bool rst_set = rtcp->rst;
+    on_reply({ip, port}, syn_ack && !rtcp->rst);
+}
+
+// --- Поток приёма ---
+void SynEngine::receiver(const ReplyFn& on_reply) {
+    if (ring.is_open()) {
+        auto fn = [&](const uint8_t* pkt, size_t n) { on_packet(pkt, n, on_reply); };
+        uint64_t drops_seen = 0;
+        // poll() разбирает все готовые блоки, прежде чем вернуться
+        while (true) {
+            ring.poll(50, fn);
+            // Переполнение кольца — сигнал снизить темп
+            if (rate) {
+                uint64_t drops = ring.stats().drops;
+                if (drops > drops_seen) rate->dropped(drops - drops_seen);
+                drops_seen = drops;
+            }
+            if (!sending && mono_ms() > last_send_ms + (uint64_t)wait_ms) break;
+        }
+        return;
+    }
+
+    uint8_t buf[2048];
+    while (true) {
+        pollfd p{recv_fd, POLLIN, 0};
+        poll(&p, 1, 50);
+
+        // Сначала вычитываем всё, что уже в очереди, потом решаем, выходить ли
+        int n;
+        while ((p.revents & POLLIN) && (n = recv(recv_fd, buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+            on_packet(buf, n, on_reply);
+        }
+
+        if (!sending && mono_ms() > last_send_ms + (uint64_t)wait_ms) break;
+    }
+}
 
-    return (syn_set && ack_set) && !rst_set;
+// --- Запуск: отправитель в текущем потоке, приёмник — в отдельном ---
+void SynEngine::run(const NextProbeFn& next, const ReplyFn& on_reply,
+                    const ExpiredFn& on_expired) {
+    sending = true;
+    last_send_ms = mono_ms();
+    std::thread rx(&SynEngine::receiver, this, std::cref(on_reply));
+    sender(next, on_expired);
+    rx.join();
 }
 #endif
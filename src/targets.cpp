@@ -0,0 +1,227 @@
+#include "targets.hpp"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <sys/socket.h>
+
+static bool parse_ipv4(const std::string& s, uint32_t& ip) {
+    in_addr addr{};
+    if (inet_pton(AF_INET, s.c_str(), &addr) != 1) return false;
+    ip = ntohl(addr.s_addr);
+    return true;
+}
+
+static bool resolve_ipv4(const std::string& host, uint32_t& ip) {
+    addrinfo hints{};
+    hints.ai_family = AF_INET;
+    addrinfo* res = nullptr;
+    if (getaddrinfo(host.c_str(), nullptr, &hints, &res) != 0 || !res) return false;
+    ip = ntohl(((sockaddr_in*)res->ai_addr)->sin_addr.s_addr);
+    freeaddrinfo(res);
+    return true;
+}
+
+static std::string trim(const std::string& s) {
+    size_t a = s.find_first_not_of(" \t\r\n");
+    if (a == std::string::npos) return "";
+    size_t b = s.find_last_not_of(" \t\r\n");
+    return s.substr(a, b - a + 1);
+}
+
+// --- Разбор спецификаций ---
+bool TargetSet::add(const std::string& spec, std::string& err) {
+    bool ok = parse(spec, err);
+    normalize();
+    return ok;
+}
+
+bool TargetSet::parse(const std::string& spec, std::string& err) {
+    std::stringstream ss(spec);
+    std::string part;
+    while (std::getline(ss, part, ',')) {
+        part = trim(part);
+        if (!part.empty() && !add_one(part, err)) return false;
+    }
+    return true;
+}
+
+bool TargetSet::add_file(const std::string& path, std::string& err) {
+    std::ifstream in(path);
+    if (!in.is_open()) {
+        err = "cannot open " + path;
+        return false;
+    }
+    std::string line;
+    bool ok = true;
+    while (ok && std::getline(in, line)) {
+        line = trim(line.substr(0, line.find('#')));
+        if (!line.empty()) ok = parse(line, err);
+    }
+    normalize();
+    return ok;
+}
+
+bool TargetSet::add_one(const std::string& spec, std::string& err) {
+    uint32_t first = 0, last = 0;
+    size_t slash = spec.find('/');
+    size_t dash = spec.find('-');
+
+    if (slash != std::string::npos) {
+        // CIDR: 10.0.0.0/24
+        int bits = -1;
+        try {
+            bits = std::stoi(spec.substr(slash + 1));
+        } catch (...) {}
+        if (!parse_ipv4(spec.substr(0, slash), first) || bits < 0 || bits > 32) {
+            err = "bad CIDR: " + spec;
+            return false;
+        }
+        uint32_t mask = bits == 0 ? 0 : ~0u << (32 - bits);
+        first &= mask;
+        last = first | ~mask;
+    } else if (dash != std::string::npos && parse_ipv4(spec.substr(0, dash), first)) {
+        // Диапазон: 10.0.0.1-10.0.0.50 или 10.0.0.1-50 (последний октет)
+        std::string tail = spec.substr(dash + 1);
+        if (!parse_ipv4(tail, last)) {
+            int octet = -1;
+            try {
+                octet = std::stoi(tail);
+            } catch (...) {}
+            if (octet < 0 || octet > 255) {
+                err = "bad range: " + spec;
+                return false;
+            }
+            last = (first & 0xffffff00u) | (uint32_t)octet;
+        }
+        if (last < first) {
+            err = "empty range: " + spec;
+            return false;
+        }
+    } else if (!parse_ipv4(spec, first)) {
+        if (!resolve_ipv4(spec, first)) {
+            err = "cannot resolve " + spec;
+            return false;
+        }
+        last = first;
+    } else {
+        last = first;
+    }
+
+    ranges.push_back({first, last, 0});
+    return true;
+}
+
+// Сортировка и объединение пересекающихся и соседних диапазонов
+void TargetSet::normalize() {
+    std::sort(ranges.begin(), ranges.end(),
+              [](const Range& a, const Range& b) { return a.first < b.first; });
+
+    std::vector<Range> merged;
+    for (const auto& r : ranges) {
+        if (!merged.empty() && (uint64_t)r.first <= (uint64_t)merged.back().last + 1) {
+            merged.back().last = std::max(merged.back().last, r.last);
+        } else {
+            merged.push_back(r);
+        }
+    }
+
+    total = 0;
+    for (auto& r : merged) {
+        r.offset = total;
+        total += (uint64_t)r.last - r.first + 1;
+    }
+    ranges.swap(merged);
+}
+
+uint32_t TargetSet::at(uint64_t index) const {
+    // Последний диапазон, начинающийся не позже index
+    auto it = std::upper_bound(ranges.begin(), ranges.end(), index,
+                               [](uint64_t i, const Range& r) { return i < r.offset; });
+    --it;
+    return it->first + (uint32_t)(index - it->offset);
+}
+
+bool TargetSet::index_of(uint32_t ip, uint64_t& index) const {
+    // Последний диапазон, начинающийся не позже ip
+    auto it = std::upper_bound(ranges.begin(), ranges.end(), ip,
+                               [](uint32_t a, const Range& r) { return a < r.first; });
+    if (it == ranges.begin()) return false;
+    --it;
+    if (ip > it->last) return false;
+    index = it->offset + (ip - it->first);
+    return true;
+}
+
+uint64_t TargetSet::digest() const {
+    // FNV-1a по границам диапазонов
+    uint64_t h = 0xcbf29ce484222325ULL;
+    auto mix = [&h](uint32_t v) {
+        for (int i = 0; i < 4; i++) {
+            h ^= (v >> (i * 8)) & 0xff;
+            h *= 0x100000001b3ULL;
+        }
+    };
+    for (const auto& r : ranges) {
+        mix(r.first);
+        mix(r.last);
+    }
+    return h;
+}
+
+TargetSet TargetSet::subset(const std::function<bool(uint64_t)>& keep) const {
+    TargetSet out;
+    for (const auto& r : ranges) {
+        for (uint64_t k = 0; k <= (uint64_t)r.last - r.first; k++) {
+            if (!keep(r.offset + k)) continue;
+            uint32_t ip = r.first + (uint32_t)k;
+            if (!out.ranges.empty() && (uint64_t)out.ranges.back().last + 1 == ip) {
+                out.ranges.back().last = ip;
+            } else {
+                out.ranges.push_back({ip, ip, 0});
+            }
+        }
+    }
+    out.normalize();
+    return out;
+}
+
+// --- Пространство проб ---
+ProbeSpace::ProbeSpace(const TargetSet& targets, const std::vector<uint16_t>& ports, uint64_t seed,
+                       const std::vector<size_t>& tiers)
+    : targets(&targets), ports(ports), port_slot(65536, 0), tiers(tiers) {
+    for (size_t i = 0; i < ports.size(); i++) port_slot[ports[i]] = (uint16_t)i;
+    if (this->tiers.empty() || this->tiers.back() != ports.size()) this->tiers.push_back(ports.size());
+
+    // У первого яруса ключ — сам seed: без ярусов порядок тот же, что и раньше
+    size_t first = 0;
+    for (size_t end : this->tiers) {
+        uint64_t n = targets.size() * (end - first);
+        parts.push_back({first, total, Permutation(n, seed + parts.size() * 0x9e3779b97f4a7c15ULL)});
+        total += n;
+        first = end;
+    }
+}
+
+ProbeTask ProbeSpace::at(uint64_t index) const {
+    // Ярусов единицы, линейный поиск дешевле бинарного
+    size_t t = 0;
+    while (t + 1 < parts.size() && parts[t + 1].offset <= index) ++t;
+    const Tier& tier = parts[t];
+    uint64_t v = tier.perm.at(index - tier.offset);
+    uint64_t hosts = targets->size();
+    return {targets->at(v % hosts), ports[tier.first_slot + v / hosts]};
+}
+
+bool ProbeSpace::index_of(const ProbeTask& task, uint64_t& index) const {
+    uint64_t host = 0;
+    uint16_t slot = port_slot[task.port];
+    if (slot >= ports.size() || ports[slot] != task.port) return false;
+    if (!targets->index_of(task.ip, host)) return false;
+    size_t t = 0;
+    while (t + 1 < parts.size() && parts[t + 1].first_slot <= slot) ++t;
+    const Tier& tier = parts[t];
+    index = tier.offset + tier.perm.index_of((slot - tier.first_slot) * targets->size() + host);
+    return true;
+}
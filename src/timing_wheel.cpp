@@ -0,0 +1,68 @@
+#include "timing_wheel.hpp"
+
+TimingWheel::TimingWheel(uint64_t now_ms) : current(now_ms) {}
+
+void TimingWheel::add(uint64_t at_ms, uint64_t payload) {
+    ++count;
+    place({at_ms, payload});
+}
+
+// Уровень — самый нижний, на котором ячейка таймера ещё впереди текущей:
+// сравниваем не разность времён, а номера ячеек, иначе таймер мог бы попасть
+// в уже пройденную ячейку своего уровня и ждать лишний оборот
+void TimingWheel::place(const Entry& e) {
+    uint64_t at = e.at_ms < current ? current : e.at_ms;
+    for (int level = 0; level < kLevels; ++level) {
+        int shift = level * kBits;
+        if ((at >> shift) - (current >> shift) < (uint64_t)kSlots) {
+            buckets[level][(at >> shift) & (kSlots - 1)].push_back({at, e.payload});
+            return;
+        }
+    }
+    // Дальше верхнего уровня — в его последнюю ячейку, оттуда таймер спустится
+    int shift = (kLevels - 1) * kBits;
+    uint64_t top = (current >> shift) + kSlots - 1;
+    buckets[kLevels - 1][top & (kSlots - 1)].push_back({at, e.payload});
+}
+
+// Переносим ячейку уровня level, до которой дошло время, на нижние уровни
+void TimingWheel::cascade(int level) {
+    auto& bucket = buckets[level][(current >> (level * kBits)) & (kSlots - 1)];
+    std::vector<Entry> moving;
+    moving.swap(bucket);
+    for (const auto& e : moving) place(e);
+}
+
+void TimingWheel::advance(uint64_t now_ms, const FireFn& fn) {
+    while (current <= now_ms) {
+        if (count == 0) {
+            current = now_ms + 1;
+            return;
+        }
+        // На границе уровня сначала спускаем верхние, потом нижние
+        if ((current & (kSlots - 1)) == 0) {
+            int top = 1;
+            while (top < kLevels - 1 && ((current >> (top * kBits)) & (kSlots - 1)) == 0) ++top;
+            for (int level = top; level >= 1; --level) cascade(level);
+        }
+
+        // fn может положить таймер в эту же миллисекунду — крутимся до пустой ячейки
+        auto& bucket = buckets[0][current & (kSlots - 1)];
+        while (!bucket.empty()) {
+            std::vector<Entry> firing;
+            firing.swap(bucket);
+            count -= firing.size();
+            for (const auto& e : firing) fn(e.payload);
+        }
+        ++current;
+    }
+}
+
+int TimingWheel::next_timeout_ms(uint64_t now_ms) const {
+    if (count == 0) return -1;
+    uint64_t limit = ((current >> kBits) + 1) << kBits;   // следующая граница уровня 1
+    for (uint64_t t = current; t < limit; ++t) {
+        if (!buckets[0][t & (kSlots - 1)].empty()) return t > now_ms ? (int)(t - now_ms) : 0;
+    }
+    return limit > now_ms ? (int)(limit - now_ms) : 0;
+}
@@ -0,0 +1,349 @@
+#include "tls_probe.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+// --- ClientHello ---
+static void put16(std::string& out, size_t v) {
+    out += (char)(v >> 8);
+    out += (char)v;
+}
+
+static void put24(std::string& out, size_t v) {
+    out += (char)(v >> 16);
+    put16(out, v);
+}
+
+static std::string build_client_hello() {
+    // Шифры, которые поддерживает почти любой сервер TLS 1.0-1.2
+    static const uint16_t kCiphers[] = {
+        0xc02b, 0xc02f, 0xc02c, 0xc030, 0xcca9, 0xcca8,  // ECDHE + AEAD
+        0xc009, 0xc013, 0xc00a, 0xc014,                  // ECDHE + CBC
+        0x009c, 0x009d, 0x002f, 0x0035, 0x000a,          // RSA
+    };
+    static const uint16_t kGroups[] = {0x001d, 0x0017, 0x0018, 0x0019};
+    static const uint16_t kSigAlgs[] = {
+        0x0403, 0x0503, 0x0603, 0x0804, 0x0805, 0x0806, 0x0401, 0x0501, 0x0601, 0x0203, 0x0201,
+    };
+
+    std::string ext;
+    put16(ext, 0x000a);  // supported_groups
+    put16(ext, 2 + sizeof(kGroups));
+    put16(ext, sizeof(kGroups));
+    for (uint16_t g : kGroups) put16(ext, g);
+    put16(ext, 0x000b);  // ec_point_formats: uncompressed
+    put16(ext, 2);
+    ext += '\x01';
+    ext += '\x00';
+    put16(ext, 0x000d);  // signature_algorithms
+    put16(ext, 2 + sizeof(kSigAlgs));
+    put16(ext, sizeof(kSigAlgs));
+    for (uint16_t a : kSigAlgs) put16(ext, a);
+    put16(ext, 0x0017);  // extended_master_secret
+    put16(ext, 0);
+    put16(ext, 0xff01);  // renegotiation_info
+    put16(ext, 1);
+    ext += '\x00';
+
+    std::string body;
+    put16(body, 0x0303);
+    for (int i = 0; i < 32; i++) body += (char)(0x5a ^ i);  // random: серверу всё равно
+    body += '\x00';                                         // без session id
+    put16(body, sizeof(kCiphers));
+    for (uint16_t c : kCiphers) put16(body, c);
+    body += '\x01';                                         // compression: null
+    body += '\x00';
+    put16(body, ext.size());
+    body += ext;
+
+    std::string hs;
+    hs += '\x01';  // ClientHello
+    put24(hs, body.size());
+    hs += body;
+
+    std::string rec;
+    rec += '\x16';  // handshake
+    put16(rec, 0x0301);
+    put16(rec, hs.size());
+    rec += hs;
+    return rec;
+}
+
+std::string_view tls_client_hello() {
+    static const std::string hello = build_client_hello();
+    return hello;
+}
+
+// --- DER ---
+// Следующий TLV в [p, end): tag, значение; p сдвигается за него
+static bool der_next(const uint8_t*& p, const uint8_t* end, uint8_t& tag, const uint8_t*& val,
+                     size_t& len) {
+    if (end - p < 2) return false;
+    tag = *p++;
+    size_t l = *p++;
+    if (l & 0x80) {
+        int k = l & 0x7f;
+        if (k == 0 || k > 4 || end - p < k) return false;
+        l = 0;
+        while (k--) l = l << 8 | *p++;
+    }
+    if ((size_t)(end - p) < l) return false;
+    val = p;
+    len = l;
+    p += l;
+    return true;
+}
+
+static bool oid_is(const uint8_t* v, size_t n, const char* oid, size_t oid_len) {
+    return n == oid_len && std::memcmp(v, oid, n) == 0;
+}
+
+// Строковое значение атрибута имени; BMPString сводится к ASCII
+static void append_der_string(std::string& out, uint8_t tag, const uint8_t* v, size_t n) {
+    if (tag == 0x1e) {
+        for (size_t i = 1; i < n; i += 2) out += (char)v[i];
+    } else {
+        out.append((const char*)v, n);
+    }
+}
+
+// Name: SEQUENCE OF SET OF { OID, значение } -> "CN=...,O=..."
+static std::string name_to_string(const uint8_t* p, size_t n) {
+    static const struct { const char* oid; const char* label; } kAttrs[] = {
+        {"\x55\x04\x03", "CN"}, {"\x55\x04\x06", "C"}, {"\x55\x04\x07", "L"},
+        {"\x55\x04\x08", "ST"}, {"\x55\x04\x0a", "O"}, {"\x55\x04\x0b", "OU"},
+    };
+    std::string out;
+    const uint8_t* end = p + n;
+    uint8_t tag;
+    const uint8_t* set;
+    size_t set_len;
+    while (der_next(p, end, tag, set, set_len)) {
+        const uint8_t* q = set;
+        const uint8_t* atv;
+        size_t atv_len;
+        while (der_next(q, set + set_len, tag, atv, atv_len)) {
+            const uint8_t* r = atv;
+            const uint8_t *oid, *val;
+            size_t oid_len, val_len;
+            uint8_t vtag;
+            if (!der_next(r, atv + atv_len, tag, oid, oid_len) || tag != 0x06 ||
+                !der_next(r, atv + atv_len, vtag, val, val_len)) {
+                continue;
+            }
+            for (const auto& a : kAttrs) {
+                if (!oid_is(oid, oid_len, a.oid, 3)) continue;
+                if (!out.empty()) out += ',';
+                out += a.label;
+                out += '=';
+                append_der_string(out, vtag, val, val_len);
+            }
+        }
+    }
+    return out;
+}
+
+// UTCTime/GeneralizedTime -> "YYYY-MM-DDTHH:MM:SSZ"
+static std::string der_time(uint8_t tag, const uint8_t* v, size_t n) {
+    std::string s((const char*)v, n);
+    if (tag == 0x17 && n >= 12) {
+        s = (s[0] < '5' ? "20" : "19") + s;
+    } else if (tag != 0x18 || n < 14) {
+        return s;
+    }
+    return s.substr(0, 4) + "-" + s.substr(4, 2) + "-" + s.substr(6, 2) + "T" + s.substr(8, 2) +
+           ":" + s.substr(10, 2) + ":" + s.substr(12, 2) + "Z";
+}
+
+// subjectAltName: SEQUENCE OF GeneralName
+static void parse_san(const uint8_t* p, size_t n, std::vector<std::string>& out) {
+    const uint8_t* end = p + n;
+    uint8_t tag;
+    const uint8_t* seq;
+    size_t seq_len;
+    if (!der_next(p, end, tag, seq, seq_len) || tag != 0x30) return;
+    p = seq;
+    end = seq + seq_len;
+    const uint8_t* v;
+    size_t len;
+    while (der_next(p, end, tag, v, len)) {
+        if (tag == 0x82) {  // dNSName
+            out.emplace_back((const char*)v, len);
+        } else if (tag == 0x87 && len == 4) {  // iPAddress v4
+            char buf[16];
+            std::snprintf(buf, sizeof(buf), "%u.%u.%u.%u", v[0], v[1], v[2], v[3]);
+            out.emplace_back(buf);
+        } else if (tag == 0x87 && len == 16) {  // v6, без сжатия нулей
+            std::string ip;
+            char buf[8];
+            for (int i = 0; i < 16; i += 2) {
+                std::snprintf(buf, sizeof(buf), i ? ":%x" : "%x", v[i] << 8 | v[i + 1]);
+                ip += buf;
+            }
+            out.push_back(ip);
+        }
+    }
+}
+
+// Certificate ::= SEQUENCE { tbsCertificate, signatureAlgorithm, signature }
+bool parse_certificate(const uint8_t* der, size_t n, CertInfo& out) {
+    const uint8_t* p = der;
+    uint8_t tag;
+    const uint8_t *cert, *tbs, *v;
+    size_t cert_len, tbs_len, len;
+    if (!der_next(p, der + n, tag, cert, cert_len) || tag != 0x30) return false;
+    p = cert;
+    if (!der_next(p, cert + cert_len, tag, tbs, tbs_len) || tag != 0x30) return false;
+
+    // version [0] (необязательный), serialNumber, signature, issuer, validity, subject, spki
+    p = tbs;
+    const uint8_t* end = tbs + tbs_len;
+    if (!der_next(p, end, tag, v, len)) return false;
+    if (tag == 0xa0 && !der_next(p, end, tag, v, len)) return false;  // serialNumber
+    if (!der_next(p, end, tag, v, len)) return false;                  // signature
+    if (!der_next(p, end, tag, v, len) || tag != 0x30) return false;
+    out.issuer = name_to_string(v, len);
+    if (!der_next(p, end, tag, v, len) || tag != 0x30) return false;
+    const uint8_t* q = v;
+    const uint8_t* t;
+    size_t t_len;
+    if (der_next(q, v + len, tag, t, t_len)) out.not_before = der_time(tag, t, t_len);
+    if (der_next(q, v + len, tag, t, t_len)) out.not_after = der_time(tag, t, t_len);
+    if (!der_next(p, end, tag, v, len) || tag != 0x30) return false;
+    out.subject = name_to_string(v, len);
+    if (!der_next(p, end, tag, v, len)) return false;                  // subjectPublicKeyInfo
+
+    // extensions [3] EXPLICIT SEQUENCE OF Extension
+    while (der_next(p, end, tag, v, len)) {
+        if (tag != 0xa3) continue;
+        const uint8_t* e = v;
+        const uint8_t* seq;
+        size_t seq_len;
+        if (!der_next(e, v + len, tag, seq, seq_len) || tag != 0x30) break;
+        e = seq;
+        const uint8_t* ext;
+        size_t ext_len;
+        while (der_next(e, seq + seq_len, tag, ext, ext_len)) {
+            const uint8_t* x = ext;
+            const uint8_t *oid, *val;
+            size_t oid_len, val_len;
+            if (!der_next(x, ext + ext_len, tag, oid, oid_len) || tag != 0x06) continue;
+            if (!oid_is(oid, oid_len, "\x55\x1d\x11", 3)) continue;
+            if (!der_next(x, ext + ext_len, tag, val, val_len)) continue;
+            if (tag == 0x01 && !der_next(x, ext + ext_len, tag, val, val_len)) continue;  // critical
+            if (tag == 0x04) parse_san(val, val_len, out.san);
+        }
+    }
+    return true;
+}
+
+// --- Ответ сервера ---
+TlsReader::Status TlsReader::feed(const char* data, size_t n) {
+    pending.append(data, n);
+    const uint8_t* p = (const uint8_t*)pending.data();
+    size_t off = 0;
+    while (pending.size() - off >= 5) {
+        uint8_t type = p[off];
+        size_t len = (size_t)p[off + 3] << 8 | p[off + 4];
+        // 20..23 — ChangeCipherSpec, Alert, Handshake, ApplicationData; 2^14 + 2048 — предел записи
+        if (type < 20 || type > 23 || p[off + 1] != 3 || len > 18432) {
+            return started() ? Status::DONE : Status::NOT_TLS;
+        }
+        if (pending.size() - off - 5 < len) break;
+        const uint8_t* payload = p + off + 5;
+        off += 5 + len;
+
+        if (type == 21) {
+            if (len >= 2) alert = payload[1];
+            return Status::DONE;
+        }
+        // Дальше всё зашифровано (так идёт TLS 1.3 после ServerHello)
+        if (type != 22) return started() ? Status::DONE : Status::NOT_TLS;
+        handshake.append((const char*)payload, len);
+        Status st = handshake_messages();
+        if (st != Status::MORE) return st;
+    }
+    pending.erase(0, off);
+    if (pending.size() + handshake.size() > kMaxBuffered) return Status::DONE;
+    return Status::MORE;
+}
+
+TlsReader::Status TlsReader::handshake_messages() {
+    const uint8_t* p = (const uint8_t*)handshake.data();
+    size_t off = 0;
+    while (handshake.size() - off >= 4) {
+        uint8_t type = p[off];
+        size_t len = (size_t)p[off + 1] << 16 | (size_t)p[off + 2] << 8 | p[off + 3];
+        if (handshake.size() - off - 4 < len) break;
+        const uint8_t* body = p + off + 4;
+        off += 4 + len;
+
+        if (type == 2) {  // ServerHello
+            if (!server_hello(body, len)) return Status::NOT_TLS;
+            if (version == 0x0304) return Status::DONE;
+        } else if (type == 11) {  // Certificate: certificate_list<3>, первый — листовой
+            if (len >= 6) {
+                size_t cert_len = (size_t)body[3] << 16 | (size_t)body[4] << 8 | body[5];
+                if (cert_len <= len - 6) have_cert = parse_certificate(body + 6, cert_len, cert);
+            }
+            return Status::DONE;
+        } else if (type == 14) {  // ServerHelloDone без сертификата (anon, PSK)
+            return Status::DONE;
+        }
+    }
+    handshake.erase(0, off);
+    return Status::MORE;
+}
+
+bool TlsReader::server_hello(const uint8_t* p, size_t n) {
+    // version<2> random<32> session_id<1> cipher<2> compression<1> extensions<2>
+    if (n < 38 || n < 38 + (size_t)p[34] + 3) return false;
+    version = (uint16_t)(p[0] << 8 | p[1]);
+    size_t off = 35 + p[34];
+    cipher = (uint16_t)(p[off] << 8 | p[off + 1]);
+    off += 3;
+    if (n - off < 2) return true;
+    size_t ext_end = std::min(n, off + 2 + ((size_t)p[off] << 8 | p[off + 1]));
+    off += 2;
+    while (ext_end - off >= 4) {
+        uint16_t type = (uint16_t)(p[off] << 8 | p[off + 1]);
+        size_t len = (size_t)p[off + 2] << 8 | p[off + 3];
+        off += 4;
+        if (ext_end - off < len) break;
+        if (type == 0x002b && len == 2) version = (uint16_t)(p[off] << 8 | p[off + 1]);
+        off += len;
+    }
+    return true;
+}
+
+std::string TlsReader::summary() const {
+    std::string s;
+    switch (version) {
+        case 0x0300: s = "SSLv3"; break;
+        case 0x0301: s = "TLSv1.0"; break;
+        case 0x0302: s = "TLSv1.1"; break;
+        case 0x0303: s = "TLSv1.2"; break;
+        case 0x0304: s = "TLSv1.3"; break;
+        default: s = "TLS"; break;
+    }
+    char buf[32];
+    if (cipher) {
+        std::snprintf(buf, sizeof(buf), " cipher=0x%04x", cipher);
+        s += buf;
+    }
+    if (alert >= 0) s += " alert=" + std::to_string(alert);
+    if (have_cert) {
+        s += " subject=\"" + cert.subject + "\" issuer=\"" + cert.issuer + "\"";
+        if (!cert.san.empty()) {
+            s += " san=";
+            for (size_t i = 0; i < cert.san.size(); i++) {
+                if (s.size() + cert.san[i].size() + 64 > kMaxTlsBannerLen) break;
+                if (i) s += ',';
+                s += cert.san[i];
+            }
+        }
+        s += " not_before=" + cert.not_before + " not_after=" + cert.not_after;
+    }
+    if (s.size() > kMaxTlsBannerLen) s.resize(kMaxTlsBannerLen);
+    return s;
+}
@@ -0,0 +1,417 @@
+#include "udp_engine.hpp"
+#include "ports.hpp"
+#include <iostream>
+#include <vector>
+
+using namespace std::literals;
+
+// --- Нагрузки проб по портам ---
+struct UdpProbe {
+    const char* name;
+    std::string_view payload;
+    const char* ports;  // в синтаксисе -p
+};
+
+static const UdpProbe kUdpProbes[] = {
+    // version.bind CH TXT; id тот же, что у TCP-пробы, — для одной сигнатуры
+    {"dns", "\x00\x06\x00\x00\x00\x01\x00\x00\x00\x00\x00\x00"
+            "\x07" "version" "\x04" "bind" "\x00" "\x00\x10\x00\x03"sv, "53"},
+    // Клиентский запрос NTPv4 (LI=3, VN=4, mode=3), остальное нули
+    {"ntp", "\xe3\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"
+            "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"
+            "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"sv, "123"},
+    // NBSTAT на имя "*"
+    {"netbios", "\x80\xf0\x00\x10\x00\x01\x00\x00\x00\x00\x00\x00"
+                "\x20" "CKAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA" "\x00" "\x00\x21\x00\x01"sv, "137"},
+    // SNMPv2c GetRequest sysDescr.0, community public
+    {"snmp", "\x30\x29\x02\x01\x01\x04\x06" "public"
+             "\xa0\x1c\x02\x04\x12\x34\x56\x78\x02\x01\x00\x02\x01\x00"
+             "\x30\x0e\x30\x0c\x06\x08\x2b\x06\x01\x02\x01\x01\x01\x00\x05\x00"sv, "161"},
+    // IKEv1 Main Mode: одно предложение 3DES/SHA1/PSK/MODP1024
+    {"ike", "\x11\x22\x33\x44\x55\x66\x77\x88" "\x00\x00\x00\x00\x00\x00\x00\x00"
+            "\x01\x10\x02\x00" "\x00\x00\x00\x00" "\x00\x00\x00\x50"
+            "\x00\x00\x00\x34" "\x00\x00\x00\x01" "\x00\x00\x00\x01"
+            "\x00\x00\x00\x28" "\x01\x01\x00\x01"
+            "\x00\x00\x00\x20" "\x01\x01\x00\x00"
+            "\x80\x01\x00\x05" "\x80\x02\x00\x02" "\x80\x03\x00\x01"
+            "\x80\x04\x00\x02" "\x80\x0b\x00\x01" "\x80\x0c\x70\x80"sv, "500,4500"},
+    {"ssdp", "M-SEARCH * HTTP/1.1\r\nHOST: 239.255.255.250:1900\r\n"
+             "MAN: \"ssdp:discover\"\r\nMX: 1\r\nST: ssdp:all\r\n\r\n"sv, "1900"},
+    // PTR _services._dns-sd._udp.local, ответ unicast
+    {"mdns", "\x00\x00\x00\x00\x00\x01\x00\x00\x00\x00\x00\x00"
+             "\x09" "_services" "\x07" "_dns-sd" "\x04" "_udp" "\x05" "local" "\x00"
+             "\x00\x0c\x80\x01"sv, "5353"},
+    // Заголовок кадра memcached UDP (id, seq, всего 1) + текстовая команда
+    {"memcached", "\x00\x01\x00\x00\x00\x01\x00\x00" "version\r\n"sv, "11211"},
+};
+
+std::string_view udp_payload(uint16_t port) {
+    // Номер пробы + 1 для каждого порта, строится один раз
+    static const std::vector<uint8_t> index = [] {
+        std::vector<uint8_t> out(65536, 0);
+        uint8_t n = 0;
+        for (const auto& p : kUdpProbes) {
+            ++n;
+            PortSet set;
+            std::string err;
+            if (!PortSet::parse(p.ports, set, err)) {
+                std::cerr << "[!] UDP probe " << p.name << ": " << err << "\n";
+                continue;
+            }
+            for (uint16_t port : set) {
+                if (!out[port]) out[port] = n;
+            }
+        }
+        return out;
+    }();
+    return index[port] ? kUdpProbes[index[port] - 1].payload : std::string_view();
+}
+
+#ifdef __linux__
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/ip_icmp.h>
+#include <netinet/udp.h>
+#include <linux/errqueue.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <thread>
+#include "timing_wheel.hpp"
+
+// Датаграмм на один вызов sendmmsg()/recvmmsg()
+static const int kSendBatch = 256;
+static const int kRecvBatch = 64;
+// От ответа хватает начала — в баннер всё равно идёт не больше kMaxBannerLen
+static const size_t kRecvLen = 512;
+// Сколько ждать освобождения буфера отправки, прежде чем бросить пакет
+static const uint64_t kSendStallMs = 200;
+
+static uint64_t mono_ms() {
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static uint64_t mono_us() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static uint64_t probe_key(uint32_t ip, uint16_t port) { return ((uint64_t)ip << 16) | port; }
+
+// --- Конструктор ---
+UdpEngine::UdpEngine(RttEstimator& rtt, int retries, size_t max_outstanding, int pps)
+    : rtt(rtt), retries(std::clamp(retries, 0, 255)), pps(std::max(0, pps)),
+      inflight(max_outstanding) {}
+
+UdpEngine::~UdpEngine() {
+    if (fd >= 0) close(fd);
+    if (icmp_fd >= 0) close(icmp_fd);
+}
+
+bool UdpEngine::open() {
+    fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) return false;
+    int sndbuf = 4 << 20;
+    int rcvbuf = 8 << 20;
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    // Порт источника один на весь скан: по нему узнаются свои ICMP-ошибки
+    sockaddr_in local{};
+    local.sin_family = AF_INET;
+    socklen_t len = sizeof(local);
+    if (bind(fd, (sockaddr*)&local, sizeof(local)) < 0 ||
+        getsockname(fd, (sockaddr*)&local, &len) < 0) {
+        return false;
+    }
+    local_port = ntohs(local.sin_port);
+
+    // IP_RECVERR нужен в любом случае: без него ядро молча глотает ENOBUFS от
+    // переполненной очереди устройства. Заодно ICMP-ошибки ложатся в очередь
+    // сокета — без root это единственный источник закрытых портов
+    int on = 1;
+    setsockopt(fd, SOL_IP, IP_RECVERR, &on, sizeof(on));
+
+    // С root ICMP читаем raw-сокетом; дубли с очередью ошибок отсекает answer()
+    icmp_fd = socket(AF_INET, SOCK_RAW | SOCK_NONBLOCK, IPPROTO_ICMP);
+    if (icmp_fd >= 0) setsockopt(icmp_fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    return true;
+}
+
+// --- Отправка пачки: частичные отправки досылаются ---
+void UdpEngine::flush(mmsghdr* msgs, int n) {
+    int sent = 0;
+    uint64_t stalled_since = 0;
+    while (sent < n) {
+        int r = sendmmsg(fd, &msgs[sent], n - sent, 0);
+        if (r > 0) {
+            sent += r;
+            stalled_since = 0;
+        } else if (errno == ECONNREFUSED) {
+            // С IP_RECVERR ядро отдаёт отложенную ICMP-ошибку и первому вызову
+            // отправки; сама ошибка уже лежит в очереди — просто повторяем
+            continue;
+        } else if (errno == ENOBUFS || errno == EAGAIN || errno == EINTR) {
+            uint64_t now = mono_ms();
+            if (stalled_since == 0) {
+                stalled_since = now;
+                // Очередь на отправку переполнена — отправляем быстрее, чем уходит
+                if (rate && errno != EINTR) rate->dropped(1);
+            }
+            if (now - stalled_since < kSendStallMs) {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+                continue;
+            }
+            ++send_errors;
+            last_send_errno = errno;
+            ++sent;
+            stalled_since = 0;
+        } else {
+            // EPERM от файрвола, EHOSTUNREACH и т.п. — теряем голову пачки
+            ++send_errors;
+            last_send_errno = errno;
+            ++sent;
+        }
+    }
+}
+
+// Снимаем пробу с повторов; RTT — только по первой попытке (алгоритм Карна)
+bool UdpEngine::answer(uint32_t ip, uint16_t port) {
+    uint8_t attempt = 0;
+    uint64_t sent_us = 0;
+    if (!inflight.mark_answered(ip, port, attempt, sent_us)) return false;
+    if (attempt == 0) rtt.sample(ip, mono_us() - sent_us);
+    if (rate) rate->answered(attempt);
+    return true;
+}
+
+// --- Приём: UDP-ответы пачками через recvmmsg ---
+void UdpEngine::drain_replies(const ReplyFn& on_reply) {
+    char bufs[kRecvBatch][kRecvLen];
+    sockaddr_in srcs[kRecvBatch];
+    iovec iovs[kRecvBatch];
+    mmsghdr msgs[kRecvBatch];
+    while (true) {
+        for (int i = 0; i < kRecvBatch; i++) {
+            iovs[i] = {bufs[i], kRecvLen};
+            msgs[i] = {};
+            msgs[i].msg_hdr.msg_name = &srcs[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        int n = recvmmsg(fd, msgs, kRecvBatch, MSG_DONTWAIT, nullptr);
+        if (n < 0 && (errno == ECONNREFUSED || errno == EINTR)) continue;
+        if (n <= 0) return;
+        for (int i = 0; i < n; i++) {
+            uint32_t ip = ntohl(srcs[i].sin_addr.s_addr);
+            uint16_t port = ntohs(srcs[i].sin_port);
+            if (answer(ip, port)) {
+                on_reply({ip, port}, Reply::OPEN, bufs[i],
+                         std::min<size_t>(msgs[i].msg_len, kRecvLen));
+            }
+        }
+        if (n < kRecvBatch) return;
+    }
+}
+
+// Destination unreachable на пробу (ip, port)
+void UdpEngine::on_unreachable(uint32_t ip, uint16_t port, uint8_t code,
+                               const ReplyFn& on_reply) {
+    Reply kind;
+    switch (code) {
+    case ICMP_PORT_UNREACH:
+        kind = Reply::CLOSED;
+        break;
+    case ICMP_NET_UNREACH:
+    case ICMP_HOST_UNREACH:
+    case ICMP_PROT_UNREACH:
+    case ICMP_NET_ANO:
+    case ICMP_HOST_ANO:
+    case ICMP_PKT_FILTERED:
+        kind = Reply::FILTERED;
+        break;
+    default:
+        return;
+    }
+    if (answer(ip, port)) on_reply({ip, port}, kind, nullptr, 0);
+}
+
+// --- ICMP через raw-сокет: IP | ICMP | исходный IP | первые 8 байт UDP ---
+void UdpEngine::drain_icmp(const ReplyFn& on_reply) {
+    uint8_t buf[1500];
+    ssize_t n;
+    while ((n = recv(icmp_fd, buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+        auto* outer = (const iphdr*)buf;
+        size_t off = outer->ihl * 4;
+        if ((size_t)n < off + 8 + sizeof(iphdr)) continue;
+        auto* icmp = (const icmphdr*)(buf + off);
+        if (icmp->type != ICMP_DEST_UNREACH) continue;
+
+        auto* inner = (const iphdr*)(buf + off + 8);
+        size_t inner_off = off + 8 + inner->ihl * 4;
+        if (inner->protocol != IPPROTO_UDP || (size_t)n < inner_off + sizeof(udphdr)) continue;
+        auto* udp = (const udphdr*)(buf + inner_off);
+        // Чужие ошибки (другие процессы, другие сканы) отсекаются по порту источника
+        if (ntohs(udp->source) != local_port) continue;
+
+        on_unreachable(ntohl(inner->daddr), ntohs(udp->dest), icmp->code, on_reply);
+    }
+}
+
+// --- ICMP через очередь ошибок сокета (IP_RECVERR, без root) ---
+void UdpEngine::drain_errqueue(const ReplyFn& on_reply) {
+    char data[64];
+    char control[256];
+    while (true) {
+        sockaddr_in dst{};
+        iovec iov{data, sizeof(data)};
+        msghdr msg{};
+        msg.msg_name = &dst;
+        msg.msg_namelen = sizeof(dst);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) return;
+
+        for (cmsghdr* c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+            if (c->cmsg_level != SOL_IP || c->cmsg_type != IP_RECVERR) continue;
+            auto* ee = (const sock_extended_err*)CMSG_DATA(c);
+            if (ee->ee_origin != SO_EE_ORIGIN_ICMP || ee->ee_type != ICMP_DEST_UNREACH) continue;
+            // msg_name — адрес, куда шла проба
+            on_unreachable(ntohl(dst.sin_addr.s_addr), ntohs(dst.sin_port), ee->ee_code,
+                           on_reply);
+        }
+    }
+}
+
+// --- Цикл: отправка с темпом pps, повторы по колесу таймеров, приём ---
+void UdpEngine::run(const NextProbeFn& next, const ReplyFn& on_reply,
+                    const ExpiredFn& on_expired) {
+    TimingWheel timers(mono_ms());
+    // Повторы, которым пора уйти; идут раньше новых проб
+    std::deque<uint64_t> due;
+    std::vector<sockaddr_in> dsts(kSendBatch);
+    std::vector<iovec> iovs(kSendBatch);
+    std::vector<mmsghdr> msgs(kSendBatch);
+    int n = 0;
+
+    // Ведро токенов: pps в секунду, запас — на одну пачку
+    const double burst = std::max(1.0, std::min<double>(kSendBatch, pps / 100.0));
+    double tokens = burst;
+    uint64_t refilled_us = mono_us();
+    auto refill = [&]() {
+        if (pps == 0) return;
+        uint64_t now = mono_us();
+        tokens = std::min(burst, tokens + (now - refilled_us) * pps / 1e6);
+        refilled_us = now;
+    };
+    // Токен нужен и от своего ведра, и от общего контроллера
+    auto can_send = [&]() {
+        if (pps != 0 && tokens < 1.0) return false;
+        return !rate || credit > 0 || (credit = rate->take(kRateChunk)) > 0;
+    };
+
+    auto queue = [&](uint32_t ip, uint16_t port) {
+        std::string_view payload = udp_payload(port);
+        dsts[n] = {};
+        dsts[n].sin_family = AF_INET;
+        dsts[n].sin_addr.s_addr = htonl(ip);
+        dsts[n].sin_port = htons(port);
+        iovs[n] = {(void*)payload.data(), payload.size()};
+        msgs[n] = {};
+        msgs[n].msg_hdr.msg_name = &dsts[n];
+        msgs[n].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+        msgs[n].msg_hdr.msg_iov = &iovs[n];
+        msgs[n].msg_hdr.msg_iovlen = 1;
+        if (pps) tokens -= 1.0;
+        if (rate) --credit;
+        if (++n == kSendBatch) {
+            flush(msgs.data(), n);
+            n = 0;
+        }
+    };
+
+    // Таймаут: ответ был — проба отработала, попытки кончились — молчание
+    auto on_timer = [&](uint64_t key) {
+        uint32_t ip = (uint32_t)(key >> 16);
+        uint16_t port = (uint16_t)key;
+        uint8_t attempt = 0;
+        bool answered = false;
+        if (!inflight.lookup(ip, port, attempt, answered)) return;
+        if (answered || attempt >= retries) {
+            inflight.erase(ip, port);
+            if (!answered) {
+                ++silent_probes;
+                if (on_expired) on_expired({ip, port});
+            }
+            return;
+        }
+        due.push_back(key);
+    };
+
+    pollfd fds[2] = {{fd, POLLIN, 0}, {icmp_fd, POLLIN, 0}};
+    nfds_t nfds = icmp_fd >= 0 ? 2 : 1;
+
+    bool more = true;
+    while (more || !timers.empty() || !due.empty()) {
+        timers.advance(mono_ms(), on_timer);
+        refill();
+
+        uint64_t now_ms = mono_ms();
+        uint64_t now_us = mono_us();
+        while (!due.empty() && can_send()) {
+            uint64_t key = due.front();
+            due.pop_front();
+            uint32_t ip = (uint32_t)(key >> 16);
+            uint16_t port = (uint16_t)key;
+            uint8_t attempt = 0;
+            bool answered = false;
+            inflight.lookup(ip, port, attempt, answered);
+            // Ответ успел прийти, пока повтор ждал своей очереди
+            if (!inflight.retry(ip, port, attempt + 1, now_us)) {
+                inflight.erase(ip, port);
+                continue;
+            }
+            queue(ip, port);
+            timers.add(now_ms + (uint64_t)rtt.timeout_ms(ip, attempt + 1), key);
+        }
+
+        ProbeTask t{};
+        while (more && due.empty() && can_send() && !inflight.full() && (more = next(t))) {
+            inflight.insert(t.ip, t.port, now_us);
+            queue(t.ip, t.port);
+            timers.add(now_ms + (uint64_t)rtt.timeout_ms(t.ip), probe_key(t.ip, t.port));
+        }
+        if (n > 0) {
+            flush(msgs.data(), n);
+            n = 0;
+        }
+
+        // Ждём ответов до ближайшего таймаута или следующего токена
+        int wait = timers.next_timeout_ms(mono_ms());
+        bool want_send = !due.empty() || (more && !inflight.full());
+        if (want_send && !can_send()) {
+            int token_ms = pps != 0 && tokens < 1.0 ? (int)((1.0 - tokens) * 1000 / pps) + 1
+                                                    : std::max(rate->wait_ms(), 1);
+            wait = wait < 0 ? token_ms : std::min(wait, token_ms);
+        } else if (want_send) {
+            wait = 0;
+        }
+        if (wait < 0 || wait > 10) wait = 10;
+
+        fds[0].revents = fds[1].revents = 0;
+        if (poll(fds, nfds, wait) <= 0) continue;
+        if (fds[0].revents & POLLIN) drain_replies(on_reply);
+        if (fds[0].revents & POLLERR) drain_errqueue(on_reply);
+        if (nfds > 1 && (fds[1].revents & POLLIN)) drain_icmp(on_reply);
+    }
+}
+#endif
@@ -0,0 +1,388 @@
+#include "uring_engine.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+// Коды операций в user_data: (gen << 32) | (slot << 4) | op
+enum : uint64_t { OP_CONNECT = 1, OP_CLOSE, OP_TIMEOUT };
+
+struct UringEngine::Slot {
+    int fd = -1;
+    uint32_t gen = 0;
+    Stage stage = Stage::IDLE;
+    ProbeTask task{};
+    uint64_t started_us = 0;
+    sockaddr_in addr{};
+    __kernel_timespec ts{};
+    uint8_t attempt = 0;
+    bool retry = false;   // после CLOSE вернуть пробу в очередь повторов
+};
+
+struct UringEngine::Ring {
+    int fd = -1;
+    unsigned* sq_head = nullptr;
+    unsigned* sq_tail = nullptr;
+    unsigned* sq_mask = nullptr;
+    unsigned* sq_array = nullptr;
+    unsigned sq_entries = 0;
+    unsigned* cq_head = nullptr;
+    unsigned* cq_tail = nullptr;
+    unsigned* cq_mask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+    io_uring_sqe* sqes = nullptr;
+
+    void* sq_ptr = MAP_FAILED;
+    size_t sq_len = 0;
+    void* cq_ptr = MAP_FAILED;
+    size_t cq_len = 0;
+    size_t sqes_len = 0;
+
+    bool init(unsigned entries, unsigned cq_entries) {
+        io_uring_params p{};
+        p.flags = IORING_SETUP_CQSIZE;
+        p.cq_entries = cq_entries;
+        fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+        if (fd < 0) return false;
+
+        sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_len = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+        if (single) sq_len = cq_len = std::max(sq_len, cq_len);
+
+        sq_ptr = mmap(nullptr, sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      fd, IORING_OFF_SQ_RING);
+        if (sq_ptr == MAP_FAILED) return false;
+        if (single) {
+            cq_ptr = sq_ptr;
+        } else {
+            cq_ptr = mmap(nullptr, cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          fd, IORING_OFF_CQ_RING);
+            if (cq_ptr == MAP_FAILED) return false;
+        }
+        sqes_len = p.sq_entries * sizeof(io_uring_sqe);
+        void* s = mmap(nullptr, sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       fd, IORING_OFF_SQES);
+        if (s == MAP_FAILED) return false;
+        sqes = (io_uring_sqe*)s;
+
+        auto* sq = (char*)sq_ptr;
+        sq_head = (unsigned*)(sq + p.sq_off.head);
+        sq_tail = (unsigned*)(sq + p.sq_off.tail);
+        sq_mask = (unsigned*)(sq + p.sq_off.ring_mask);
+        sq_array = (unsigned*)(sq + p.sq_off.array);
+        sq_entries = p.sq_entries;
+        auto* cq = (char*)cq_ptr;
+        cq_head = (unsigned*)(cq + p.cq_off.head);
+        cq_tail = (unsigned*)(cq + p.cq_off.tail);
+        cq_mask = (unsigned*)(cq + p.cq_off.ring_mask);
+        cqes = (io_uring_cqe*)(cq + p.cq_off.cqes);
+        return true;
+    }
+
+    ~Ring() {
+        if (sqes) munmap(sqes, sqes_len);
+        if (cq_ptr != MAP_FAILED && cq_ptr != sq_ptr) munmap(cq_ptr, cq_len);
+        if (sq_ptr != MAP_FAILED) munmap(sq_ptr, sq_len);
+        if (fd >= 0) close(fd);
+    }
+
+    int enter(unsigned to_submit, unsigned min_complete, unsigned flags) {
+        return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0);
+    }
+
+    // Свободное место в SQ (ядро продвигает head при сабмите)
+    unsigned sq_space() const {
+        unsigned head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+        return sq_entries - (*sq_tail - head);
+    }
+
+    io_uring_sqe* push() {
+        unsigned tail = *sq_tail;
+        unsigned i = tail & *sq_mask;
+        io_uring_sqe* sqe = &sqes[i];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sq_array[i] = i;
+        __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+        return sqe;
+    }
+};
+
+static uint64_t make_user_data(uint32_t gen, uint32_t idx, uint64_t op) {
+    return ((uint64_t)gen << 32) | ((uint64_t)idx << 4) | op;
+}
+
+static uint64_t mono_us() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static unsigned round_pow2(unsigned v) {
+    unsigned p = 1;
+    while (p < v) p <<= 1;
+    return p;
+}
+
+// --- Проверка поддержки ядром ---
+bool UringEngine::supported() {
+    Ring r;
+    if (!r.init(4, 8)) return false;
+
+    const int nops = 256;
+    std::vector<char> mem(sizeof(io_uring_probe) + nops * sizeof(io_uring_probe_op), 0);
+    auto* probe = (io_uring_probe*)mem.data();
+    if (syscall(__NR_io_uring_register, r.fd, IORING_REGISTER_PROBE, probe, nops) < 0) return false;
+
+    for (int op : {IORING_OP_CONNECT, IORING_OP_CLOSE, IORING_OP_LINK_TIMEOUT}) {
+        if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) return false;
+    }
+    return true;
+}
+
+// --- Конструктор ---
+UringEngine::UringEngine(int max_inflight, RttEstimator& rtt, int retries)
+    : max_inflight(std::clamp(max_inflight, 1, 8192)), rtt(rtt), retries(std::clamp(retries, 0, 255)) {
+    // Между двумя io_uring_enter слот кладёт в SQ не больше двух записей
+    // (CONNECT + таймаут), так что SQ такого размера не переполняется
+    unsigned entries = round_pow2(this->max_inflight * 2);
+    ring = new Ring();
+    if (!ring->init(entries, round_pow2(this->max_inflight * 4))) {
+        error = errno;
+        delete ring;
+        ring = nullptr;
+        return;
+    }
+    slots.resize(this->max_inflight);
+    for (int i = this->max_inflight - 1; i >= 0; --i) free_slots.push_back(i);
+}
+
+UringEngine::~UringEngine() {
+    for (auto& s : slots) {
+        if (s.fd >= 0) close(s.fd);
+    }
+    delete ring;
+}
+
+static void set_timeout(io_uring_sqe* sqe, __kernel_timespec* ts, int ms, uint64_t user_data) {
+    ts->tv_sec = ms / 1000;
+    ts->tv_nsec = (long long)(ms % 1000) * 1000000;
+    sqe->opcode = IORING_OP_LINK_TIMEOUT;
+    sqe->addr = (uint64_t)(uintptr_t)ts;
+    sqe->len = 1;
+    sqe->user_data = user_data;
+}
+
+// Отдаём ядру накопленные SQE; false — кольцо сломано
+bool UringEngine::submit() {
+    while (queued > 0) {
+        int r = ring->enter(queued, 0, 0);
+        if (r > 0) {
+            queued -= std::min<unsigned>(queued, (unsigned)r);
+        } else if (r < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            error = errno;
+            return false;
+        } else {
+            return true; // ядро занято — досдадим в основном цикле
+        }
+    }
+    return true;
+}
+
+// Если в SQ нет места под n записей — отдаём накопленное ядру.
+// При размере SQ из конструктора сюда на практике не попадаем.
+void UringEngine::reserve(unsigned n) {
+    if (ring->sq_space() < n && !submit()) broken = true;
+}
+
+// --- Запуск пробы: CONNECT + связанный таймаут ---
+bool UringEngine::start(const ProbeTask& task, uint8_t attempt, const DoneFn& done) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) return false;
+        done(task, false);
+        return true;
+    }
+
+    uint32_t idx = free_slots.back();
+    free_slots.pop_back();
+    Slot& s = slots[idx];
+    s.fd = fd;
+    s.task = task;
+    s.stage = Stage::CONNECT;
+    s.attempt = attempt;
+    s.retry = false;
+    s.started_us = mono_us();
+    s.addr = {};
+    s.addr.sin_family = AF_INET;
+    s.addr.sin_port = htons(task.port);
+    s.addr.sin_addr.s_addr = htonl(task.ip);
+
+    reserve(2);
+    if (broken) return true; // слот вернёт abort_outstanding()
+    io_uring_sqe* sqe = ring->push();
+    sqe->opcode = IORING_OP_CONNECT;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)&s.addr;
+    sqe->off = sizeof(s.addr);
+    sqe->flags = IOSQE_IO_LINK;
+    sqe->user_data = make_user_data(s.gen, idx, OP_CONNECT);
+    set_timeout(ring->push(), &s.ts, rtt.timeout_ms(task.ip, attempt), make_user_data(s.gen, idx, OP_TIMEOUT));
+    queued += 2;
+    return true;
+}
+
+void UringEngine::submit_close(uint32_t idx) {
+    Slot& s = slots[idx];
+    s.stage = Stage::CLOSE;
+    reserve(1);
+    if (broken) return;
+    io_uring_sqe* sqe = ring->push();
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->fd = s.fd;
+    sqe->user_data = make_user_data(s.gen, idx, OP_CLOSE);
+    queued += 1;
+}
+
+// --- Обработка CQE ---
+void UringEngine::on_complete(uint64_t user_data, int res, const DoneFn& done) {
+    uint64_t op = user_data & 0xf;
+    uint32_t idx = (uint32_t)((user_data & 0xffffffffu) >> 4);
+    uint32_t gen = (uint32_t)(user_data >> 32);
+    if (op == OP_TIMEOUT) return;
+    Slot& s = slots[idx];
+    if (s.gen != gen) return;
+
+    if (op == OP_CONNECT && s.stage == Stage::CONNECT) {
+        // res >= 0 ещё не значит, что соединение есть: проверяем сам сокет
+        sockaddr_in peer{};
+        socklen_t len = sizeof(peer);
+        bool open = res >= 0 && getpeername(s.fd, (sockaddr*)&peer, &len) == 0;
+        if (open || res == -ECONNREFUSED) {
+            rtt.sample(s.task.ip, mono_us() - s.started_us);
+            if (rate) rate->answered(s.attempt);
+        }
+        if (res == -ECANCELED && s.attempt < retries) {
+            // сработал связанный таймаут — повторим пробу, когда сокет закроется
+            s.retry = true;
+            submit_close(idx);
+            return;
+        }
+        done(s.task, open);
+        submit_close(idx);
+    } else if (op == OP_CLOSE) {
+        if (s.retry) retry_queue.push_back({s.task, (uint8_t)(s.attempt + 1)});
+        s.fd = -1;
+        s.stage = Stage::IDLE;
+        ++s.gen;
+        free_slots.push_back(idx);
+    }
+}
+
+// --- Аварийное завершение: закрываем сокеты, возвращаем незавершённые пробы ---
+void UringEngine::abort_outstanding() {
+    for (auto& s : slots) {
+        if (s.fd < 0) continue;
+        close(s.fd);
+        // CLOSE-стадия уже отчиталась через done() (кроме ждущих повтора), остальные ещё нет
+        if (s.stage == Stage::CONNECT || s.retry) {
+            leftovers.push_back(s.task);
+        }
+        s.fd = -1;
+        s.stage = Stage::IDLE;
+    }
+}
+
+// --- Основной цикл ---
+bool UringEngine::run(const NextProbeFn& next, const DoneFn& done) {
+    if (!ring) return false;
+    bool input_done = false;
+
+    while (!broken) {
+        // Сначала повторы, потом новые пробы
+        bool paced = false;
+        while (!free_slots.empty() && !broken) {
+            bool work = !retry_queue.empty() || !input_done;
+            if (rate && work && credit == 0 && (credit = rate->take(kRateChunk)) == 0) {
+                paced = true;
+                break;
+            }
+            Retry r{};
+            if (!retry_queue.empty()) {
+                r = retry_queue.back();
+                retry_queue.pop_back();
+            } else if (input_done || !next(r.task)) {
+                input_done = true;
+                break;
+            }
+            if (!start(r.task, r.attempt, done)) {
+                retry_queue.push_back(r);   // нет дескрипторов — подождём
+                break;
+            }
+            if (rate) --credit;
+        }
+        if (broken) break;
+
+        int inflight = max_inflight - (int)free_slots.size();
+        if (inflight == 0) {
+            if (input_done && retry_queue.empty()) break;
+            usleep(paced ? std::clamp(rate->wait_ms(), 1, 5) * 1000 : 5000);
+            continue;
+        }
+
+        // Ждём токен — тогда не блокируемся на CQE, а только отдаём SQE и
+        // забираем готовое
+        if (paced) {
+            unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+            if (queued == 0 && *ring->cq_head == tail) usleep(std::clamp(rate->wait_ms(), 1, 5) * 1000);
+        }
+        int r = ring->enter(queued, paced ? 0 : 1, paced ? 0 : IORING_ENTER_GETEVENTS);
+        if (r >= 0) {
+            queued -= std::min<unsigned>(queued, (unsigned)r);
+        } else if (errno != EINTR && errno != EBUSY && errno != EAGAIN) {
+            error = errno;
+            broken = true;
+            break;
+        }
+
+        unsigned head = *ring->cq_head;
+        unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+        while (head != tail) {
+            io_uring_cqe* cqe = &ring->cqes[head & *ring->cq_mask];
+            uint64_t ud = cqe->user_data;
+            int res = cqe->res;
+            ++head;
+            __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+            on_complete(ud, res, done);
+        }
+    }
+
+    if (!broken) return true;
+    abort_outstanding();
+    for (const auto& r : retry_queue) leftovers.push_back(r.task);
+    return false;
+}
+
+#else
+
+struct UringEngine::Slot {};
+struct UringEngine::Ring {};
+
+bool UringEngine::supported() { return false; }
+
+UringEngine::UringEngine(int max_inflight, RttEstimator& rtt, int retries)
+    : max_inflight(max_inflight), rtt(rtt), retries(retries) {}
+
+UringEngine::~UringEngine() {}
+
+bool UringEngine::run(const NextProbeFn&, const DoneFn&) { return false; }
+
+#endif
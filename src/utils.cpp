@@ -1,30 +1,14 @@
 #include "utils.hpp"
-#include <sstream>
-#include <iomanip>
-#include <set>
 #include <netdb.h>
 #include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
 
 uint64_t now_epoch_ms() {
     using namespace std::chrono;
     return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
 }
 
-std::string json_escape(const std::string& s) {
-    std::ostringstream o;
-    for (auto c : s) {
-        switch (c) {
-            case '\"': o << "\\\""; break;
-            case '\\': o << "\\\\"; break;
-            case '\n': o << "\\n"; break;
-            case '\r': o << "\\r"; break;
-            case '\t': o << "\\t"; break;
-            default: o << c; break;
-        }
-    }
-    return o.str();
-}
-
 std::optional<std::string> resolve_target_to_ipv4(std::string host) {
     addrinfo hints{}; hints.ai_family = AF_INET;
     addrinfo* res = nullptr;
@@ -36,21 +20,21 @@ std::optional<std::string> resolve_target_to_ipv4(std::string host) {
     return std::string(ip);
 }
 
-std::vector<int> parse_ports(const std::string& spec) {
-    std::set<int> result;
-    std::stringstream ss(spec);
-    std::string part;
-    while (std::getline(ss, part, ',')) {
-        auto dash = part.find('-');
-        if (dash == std::string::npos) {
-            int v = std::stoi(part);
-            if (v >= 1 && v <= 65535) result.insert(v);
-        } else {
-            int a = std::stoi(part.substr(0, dash));
-            int b = std::stoi(part.substr(dash + 1));
-            if (a > b) std::swap(a, b);
-            for (int x = a; x <= b; ++x) result.insert(x);
-        }
+// UDP connect ничего не отправляет, но выбирает маршрут и адрес источника
+uint32_t route_source_ip(uint32_t dst) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) return 0;
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(53);
+    addr.sin_addr.s_addr = htonl(dst);
+    sockaddr_in local{};
+    socklen_t len = sizeof(local);
+    uint32_t ip = 0;
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) == 0 &&
+        getsockname(fd, (sockaddr*)&local, &len) == 0) {
+        ip = ntohl(local.sin_addr.s_addr);
     }
-    return {result.begin(), result.end()};
+    close(fd);
+    return ip;
 }
@@ -0,0 +1,112 @@
+// scanner-convert: двоичные результаты (.scnr) -> JSON той же схемы, что у
+// scanner -o, или CSV. Файл читается через mmap, записи — без копий.
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include "json_writer.hpp"
+#include "result_file.hpp"
+
+// Поле CSV (RFC 4180): в кавычках, если в нём есть запятая, кавычка или перевод строки
+static void append_csv_field(std::string& out, std::string_view s) {
+    if (s.find_first_of(",\"\r\n") == std::string_view::npos) {
+        out.append(s.data(), s.size());
+        return;
+    }
+    out += '"';
+    for (char c : s) {
+        if (c == '"') out += '"';
+        out += c;
+    }
+    out += '"';
+}
+
+static void write_csv(const ResultFile& in, FILE* f) {
+    std::string buf = "ip,port,proto,open,service,product,version,banner\n";
+    for (uint64_t i = 0; i < in.record_count(); i++) {
+        const auto& r = in.record(i);
+        JsonWriter::append_dotted(buf, in.ip(r));
+        buf += ',';
+        JsonWriter::append_uint(buf, r.port);
+        buf += in.proto(r) == Proto::UDP ? ",udp" : ",tcp";
+        buf += r.open ? ",true," : ",false,";
+        append_csv_field(buf, in.service(r));
+        buf += ',';
+        append_csv_field(buf, in.product(r));
+        buf += ',';
+        append_csv_field(buf, in.version(r));
+        buf += ',';
+        append_csv_field(buf, in.banner(r));
+        buf += '\n';
+        if (buf.size() >= (1 << 20)) {
+            std::fwrite(buf.data(), 1, buf.size(), f);
+            buf.clear();
+        }
+    }
+    std::fwrite(buf.data(), 1, buf.size(), f);
+}
+
+static void write_json(const ResultFile& in, FILE* f) {
+    JsonWriter::Document doc(f);
+    doc.begin(in.target());
+    for (uint64_t i = 0; i < in.record_count(); i++) {
+        const auto& r = in.record(i);
+        doc.result(in.ip(r), r.port, in.proto(r), r.open, in.banner(r), in.service(r),
+                   in.product(r), in.version(r));
+    }
+    // Как и scanner -o: только хосты с замерами RTT
+    doc.hosts();
+    for (uint64_t i = 0; i < in.host_count(); i++) {
+        const auto& h = in.host(i);
+        if (h.samples) doc.host(h.ip, h.srtt_us, h.rttvar_us, h.timeout_ms, h.samples);
+    }
+    doc.end();
+}
+
+int main(int argc, char* argv[]) {
+    std::string input, output;
+    bool csv = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--csv") {
+            csv = true;
+        } else if (arg == "-o" && i + 1 < argc) {
+            output = argv[++i];
+        } else if (input.empty() && arg[0] != '-') {
+            input = arg;
+        } else {
+            input.clear();
+            break;
+        }
+    }
+    if (input.empty()) {
+        std::cerr << "Usage: " << argv[0] << " <results.scnr> [--csv] [-o output]\n";
+        return 1;
+    }
+
+    ResultFile in;
+    std::string err;
+    if (!in.open(input, err)) {
+        std::cerr << "❌ " << err << "\n";
+        return 1;
+    }
+
+    FILE* f = output.empty() ? stdout : std::fopen(output.c_str(), "w");
+    if (!f) {
+        std::cerr << "❌ " << output << ": " << std::strerror(errno) << "\n";
+        return 1;
+    }
+    if (csv) {
+        write_csv(in, f);
+    } else {
+        write_json(in, f);
+    }
+    bool ok = std::fflush(f) == 0 && !std::ferror(f);
+    if (f != stdout) ok = std::fclose(f) == 0 && ok;
+    if (!ok) {
+        std::cerr << "❌ Write failed: " << std::strerror(errno) << "\n";
+        return 1;
+    }
+    return 0;
+}